@@ -2,13 +2,13 @@
  *                                                       *
  * allocator.cpp                                         *
  *                                                       *
- * Contains implementation of Allocator class and its    *
- * nested Class struct. All methods appear in same order *
- * as in allocator.h.                                    *
+ * Contains implementation of AllocationContext class   *
+ * and its nested Class struct. All methods appear in    *
+ * same order as in allocator.h.                         *
  *                                                       *
- * Because its constructor calls assignRegister(), an    *
- * Allocator need only be constructed in order to        *
- * perform register allocation.                          *
+ * An AllocationContext is made once and then handed     *
+ * blocks one at a time: allocate() scans, parses and    *
+ * allocates a block, and emit() writes the result.      *
  *                                                       *
  * Written by: Austin James Lee                          *
  *                                                       *
@@ -16,84 +16,1051 @@
 
 #include "allocator.h"
 
+// helper function prototypes
+static int evictCost(Clean cln);
+static bool knownAddress(int addr);
+static int fold(Opcode op, int x, int y);
+static uint64_t mix(uint64_t x);
+
+
+//// SpillSlots methods ////
+
+
+// constructor for SpillSlots struct
+// slots start at SPILL until reset
+AllocationContext::SpillSlots::SpillSlots()
+			:first{SPILL}, next{SPILL}, hash{0} {}
+
+
+// resets SpillSlots to none in use, the first at address first.
+// free keeps its memory.
+void AllocationContext::SpillSlots::reset(int first) {
+	this->first = first;
+	next = first;
+	free.clear();
+	hash = 0;
+}
+
+
+// returns the lowest address free again, or else a new
+// one, for vr
+int AllocationContext::SpillSlots::take(int vr) {
+	int addr;
+	if (free.empty()) {
+		addr = next;
+		next += 4;
+	} else {
+		pop_heap(free.begin(), free.end(), greater<int>());
+		addr = free.back();
+		free.pop_back();
+		hash -= mix(~(uint64_t)addr);
+	}
+	hash += mix((uint64_t)vr << 32 | addr);
+	return addr;
+}
+
+
+// frees addr, vr's slot, for take(), if it is one of these
+// slots (a value copied into a lane keeps the address the lane
+// before gave it)
+void AllocationContext::SpillSlots::give(int addr, int vr) {
+	if (addr < first || addr >= next)
+		return;
+	free.push_back(addr);
+	push_heap(free.begin(), free.end(), greater<int>());
+	hash += mix(~(uint64_t)addr) - mix((uint64_t)vr << 32 | addr);
+}
+
+
+// returns number of slots taken since reset (no more than
+// were ever in use at once, as freed ones are taken first)
+int AllocationContext::SpillSlots::size() const {
+	return (next - first) / 4;
+}
+
+
+//// Class methods ////
+
 
 // constructor for Class struct
-// initializes each physical register properties
-// to defaults of free, invalid name, infinity next
-// use, and pushes onto stack
-Allocator::Class::Class(int numRegs) :sz{numRegs} {
+// there are no registers until reset
+AllocationContext::Class::Class()
+			:sz{0}, useHeaps{false}, remats{}, latest{}, latestLow{true},
+			numRemat{0}, numClean{0}, spills{nullptr} {}
+
+
+// resets Class to numRegs physical registers, each with
+// defaults of free, invalid name, infinity next use,
+// and pushed onto stack, and no vr resident.
+// vectors keep their memory.
+void AllocationContext::Class::reset(int numRegs, int numVRs) {
+	sz = numRegs;
+	free.assign(sz, true);
+	name.assign(sz, INVALID);
+	next.assign(sz, INT_MAX);
+	cclean.assign(sz, dirty);
+	while (!stk.empty())
+		stk.pop();
 	// reverse order so registers are allocated
 	// starting with lowest number
-	for (int i = sz - 1; i >= 0; --i) {
-		free.push_back(true);
-		name.push_back(INVALID);
-		next.push_back(INT_MAX);
-		cclean.push_back(dirty);
+	for (int i = sz - 1; i >= 0; --i)
 		stk.push(i);
+	vr2pr.assign(numVRs, INVALID);
+	known.assign(sz + 1, INVALID);
+	useHeaps = sz >= HEAP_MIN_REGS;
+	if (useHeaps) {
+		remats.reset(&next);
+		cleans.reset(&next);
+		dirties.reset(&next);
+		latest.reset(&next);
+		latestLow.reset(&next);
+		for (int i = 0; i < sz; ++i) {
+			dirties.push(i);
+			latest.push(i);
+			latestLow.push(i);
+		}
 	}
+	numRemat = 0;
+	numClean = 0;
 }
 
 
-// Allocator constructor
-// initializes values; maps source registers to virtual
-// registers, computes next use (live range) of each
-// register, and tracks number of live registers in the
-// process, all from computeLastUses(); determines if
-// need to reserve register for spilling; allocates and
-// assigns physical registers to live ranges (virtual registers);
-Allocator::Allocator(string infile, int numRegs, bool sp)
-			:intRep{Parser{infile, sp}.intRep},
-			k{numRegs}, nextMemAddr{SPILL}, maxLive{0} {
-	computeLastUses();
-	// if we don't have enough registers,
-	// reserve last register for spilling
-	if (k < maxLive)
+// sets next use of pr to nu, and moves pr
+// to its new place in the heaps
+void AllocationContext::Class::setNext(int pr, int nu) {
+	next[pr] = nu;
+	if (!useHeaps)
+		return;
+	remats.update(pr);
+	cleans.update(pr);
+	dirties.update(pr);
+	latest.update(pr);
+	latestLow.update(pr);
+}
+
+
+// sets Clean type of pr to cln, moving pr from the heap
+// of its old type to that of cln (remats, cleans or dirties)
+// and updating numRemat and numClean
+void AllocationContext::Class::setClean(int pr, Clean cln) {
+	if (cclean[pr] == cln)
+		return;
+	if (useHeaps) {
+		typeHeap(cclean[pr]).remove(pr);
+		typeHeap(cln).push(pr);
+	}
+	if (cclean[pr] == remat)
+		--numRemat;
+	if (cclean[pr] != dirty)
+		--numClean;
+	cclean[pr] = cln;
+	if (cln == remat)
+		++numRemat;
+	if (cln != dirty)
+		++numClean;
+}
+
+
+// records that pr holds constant val (INVALID if unknown)
+void AllocationContext::Class::setKnown(int pr, int val) {
+	known[pr] = val;
+}
+
+
+// returns the lowest register known to hold constant val,
+// or INVALID if there is none (only looked for by spill code)
+int AllocationContext::Class::holder(int val) const {
+	if (val == INVALID)
+		return INVALID;
+	for (int i = 0; i <= sz; ++i)
+		if (known[i] == val)
+			return i;
+	return INVALID;
+}
+
+
+// returns the heap registers of Clean type cln are kept in
+RegisterHeap& AllocationContext::Class::typeHeap(Clean cln) {
+	if (cln == remat)
+		return remats;
+	return cln == dirty ? dirties : cleans;
+}
+
+
+// returns number of registers a store could claim for its
+// address: those free, and those whose values are clean
+int AllocationContext::Class::numSpare() const {
+	return stk.size() + numClean;
+}
+
+
+// indicates whether any physical register is free
+bool AllocationContext::Class::anyFree() const {
+	return !stk.empty();
+}
+
+
+// takes the free register on top of stack and marks it in use
+int AllocationContext::Class::popFree() {
+	int pr = stk.top();
+	stk.pop();
+	free[pr] = false;
+	return pr;
+}
+
+
+// marks pr, which must be in use, free and puts it on top of stack
+void AllocationContext::Class::pushFree(int pr) {
+	assert(!free[pr]);
+	free[pr] = true;
+	stk.push(pr);
+}
+
+
+//// MaskClass methods ////
+
+
+// constructor for MaskClass struct
+// there are no registers until reset
+template <int N>
+AllocationContext::MaskClass<N>::MaskClass()
+			:sz{0}, remats{0}, cleans{0}, frees{0}, top{0}, spills{nullptr} {}
+
+
+// resets MaskClass to numRegs (at most N) physical registers,
+// with the same defaults as Class::reset
+template <int N>
+void AllocationContext::MaskClass<N>::reset(int numRegs, int numVRs) {
+	sz = numRegs;
+	remats = 0;
+	cleans = 0;
+	name.fill(INVALID);
+	next.fill(INT_MAX);
+	cclean.fill(dirty);
+	// reverse order so registers are allocated
+	// starting with lowest number
+	top = 0;
+	for (int i = sz - 1; i >= 0; --i)
+		stk[top++] = i;
+	frees = sz == 32 ? ~0u : (1u << sz) - 1;
+	vr2pr.assign(numVRs, INVALID);
+	known.fill(INVALID);
+}
+
+
+// sets next use of pr to nu
+template <int N>
+void AllocationContext::MaskClass<N>::setNext(int pr, int nu) {
+	next[pr] = nu;
+}
+
+
+// sets Clean type of pr to cln, and its bits in remats and cleans
+template <int N>
+void AllocationContext::MaskClass<N>::setClean(int pr, Clean cln) {
+	uint32_t bit = 1u << pr;
+	cclean[pr] = cln;
+	remats = cln == remat ? remats | bit : remats & ~bit;
+	cleans = cln != dirty ? cleans | bit : cleans & ~bit;
+}
+
+
+// records that pr holds constant val (INVALID if unknown)
+template <int N>
+void AllocationContext::MaskClass<N>::setKnown(int pr, int val) {
+	known[pr] = val;
+}
+
+
+// returns the lowest register known to hold constant val,
+// or INVALID if there is none
+template <int N>
+int AllocationContext::MaskClass<N>::holder(int val) const {
+	if (val == INVALID)
+		return INVALID;
+	for (int i = 0; i <= sz; ++i)
+		if (known[i] == val)
+			return i;
+	return INVALID;
+}
+
+
+// returns number of registers a store could claim for its
+// address, as for Class
+template <int N>
+int AllocationContext::MaskClass<N>::numSpare() const {
+	return top + __builtin_popcount(cleans);
+}
+
+
+// indicates whether any physical register is free
+template <int N>
+bool AllocationContext::MaskClass<N>::anyFree() const {
+	return top > 0;
+}
+
+
+// takes the free register on top of stack
+template <int N>
+int AllocationContext::MaskClass<N>::popFree() {
+	int pr = stk[--top];
+	frees &= ~(1u << pr);
+	return pr;
+}
+
+
+// puts pr, which must be in use, on top of stack
+template <int N>
+void AllocationContext::MaskClass<N>::pushFree(int pr) {
+	assert(!(frees & 1u << pr));
+	frees |= 1u << pr;
+	stk[top++] = pr;
+}
+
+
+// AllocationContext constructor
+// buffers start empty and grow with the blocks allocated
+AllocationContext::AllocationContext()
+			:numRegs{0}, threads{0}, segmented{false}, k{0}, held{INVALID},
+			stuck{false}, maxLive{0}, policy{spillCost}, pastCycles{0},
+			chunkBase{0}, side{nullptr}, out{nullptr},
+			window{0}, fed{0}, done{0}, numLanes{0}, numSlots{0},
+			spillCycles{0}, bound{0}, nodesLeft{0}, found{false},
+			lastStore{-3}, lastUnknown{-3} {}
+
+
+// scans and parses block from in straight into intRep and
+// regNames (printing tokens if sp is set), then allocates
+// numRegs registers to it (see assignBlock), on up to threads
+// threads, or one per core if threads is 0. if seg is set,
+// the block is split into lanes that are allocated at once
+// (segmented mode), which is faster on several cores for
+// large blocks, but may need some more spill code.
+// everything left from the last block is cleared first.
+void AllocationContext::allocate(Input& in, int nr, bool sp, int t, bool seg) {
+	intRep.clear();
+	regNames.reset();
+	numRegs = nr;
+	threads = t;
+	segmented = seg;
+	pastCycles = 0;
+
+	Parser {in, intRep, regNames, sp, threads};
+	assignBlock();
+}
+
+
+// writes allocated code (the IR, with the patches for each
+// instruction merged in front of it) to os.
+// rows are formatted into code, which is written out in large
+// pieces, since formatting each field through os (setw, left)
+// costs more than allocation does on large blocks.
+void AllocationContext::emit(ostream& os) {
+	code.clear();
+	int j = 0;
+	for (int i = 0; i < intRep.size(); ++i) {
+		for (; j < patches.size() && patches[j].at == i; ++j) {
+			const Patch& p = patches[j];
+			int sr[] = {p.c, INVALID, INVALID};
+			appendCode(p.op, sr, p.pr);
+		}
+		appendCode(intRep.op[i], &intRep.sr[3*i], &intRep.pr[3*i]);
+		// write out buffer when it is full
+		if (code.size() >= OUT_SIZE) {
+			os.write(code.data(), code.size());
+			code.clear();
+		}
+	}
+	os.write(code.data(), code.size());
+}
+
+
+// allocates the last block again (in segmented mode if seg
+// is set), so that both modes can be compared
+void AllocationContext::reallocate(bool seg) {
+	segmented = seg;
+	assignBlock();
+}
+
+
+// allocates the last block again (not in segmented mode),
+// picking each victim so that the allocated code takes as few
+// cycles as possible. the choices are searched depth first (see
+// searchFrom), each script of choices being tried by allocating
+// the block with it, until an allocation has used work
+// instructions. a script is cut off as soon as its spill code
+// costs as much as the cheapest found so far, and the cheapest
+// is kept. as that counts only the latency of spill code, the
+// cheapest is then checked against the last allocation (whatever
+// policy it used) by the cycles each takes with stalls (see
+// timedCycles), and if it is no faster, or none is cheaper, that
+// allocation is made again. returns true if every script was covered.
+// only victims are searched: what spill code each one needs,
+// and where it goes, is up to allocate() and ensure() as usual.
+bool AllocationContext::optimize(long work) {
+	long base = cycles();
+	for (int j = 0; j < patches.size(); ++j)
+		base -= opInfo[patches[j].op].latency;
+	long heuristic = cycles() - base;
+	long before = timedCycles();
+	segmented = false;
+	numLanes = 1;
+	prepareBlock();
+	startClean = clean;
+	startMem = vr2mem;
+	bound = heuristic;
+	seen.clear();
+	nodesLeft = max(1L, work / max(1, intRep.size()));
+	found = false;
+	withClass([&] (auto& c) {
+		searchFrom(c, vector<int>());
+		if (found) {
+			script = bestScript;
+			bound = LONG_MAX;
+			seen.clear();
+			replay(c);
+			numSlots = c.slots.size();
+		}
+	});
+	bool finished = nodesLeft >= 0;
+	if (found)
+		hoistRestores();
+	if (!found || timedCycles() >= before)
+		assignBlock();
+	return finished;
+}
+
+
+// allocates block from in as allocate() does, but without ever
+// holding more than chunk instructions of it (stream mode):
+// the parser hands the block over a chunk at a time, which goes
+// to a side file; next uses are computed from the end of the side
+// file, a chunk at a time, and written back; then the side file
+// is allocated from the start, and each chunk written to os as
+// soon as it is done. the rest of what is kept grows with the
+// number of values live at once, not the length of the block.
+// intRep is left empty (so -p has nothing to print).
+// stores claim a register for their address as they need one (see
+// allocate). one can only fail to find any if values live into the
+// block (registers it never defines) fill every register, as those
+// come in dirty where keepSpare doesn't see them. exact mode then
+// allocates the block again with the last register reserved
+// (see assignClass); that is only possible here while nothing has
+// been written, so a block with such values that is longer than a
+// chunk has it reserved from the start instead (and its code may
+// differ from exact mode's).
+void AllocationContext::stream(Input& in, ostream& os, int nr, bool sp,
+															int chunk) {
+	intRep.clear();
+	regNames.reset();
+	numRegs = nr;
+	threads = 1;
+	segmented = false;
+	pastCycles = 0;
+	numLanes = 1;
+
+	SideFile file;
+	side = &file;
+	long n = 0;
+	Parser {in, intRep, regNames, sp, chunk, [&] (IR& ir) {
+		writeChunk(n);
+		n += ir.size();
+	}};
+
+	k = numRegs;
+	while (true) {
+		patches.reset();
+		held = INVALID;
+		stuck = false;
+		maxLive = 0;
+		int liveIn = streamLastUses(n, chunk);
+		if (k == numRegs && k < maxLive && liveIn > 0 && n > chunk)
+			--k;
+		withPolicy([&] (auto p) {
+			withClass([&] (auto& c) {
+				streamClass<decltype(p)>(c, os, n, chunk);
+			});
+		});
+		if (!stuck)
+			break;
 		--k;
-	// allocate and assign physical registers
-	assignRegisters(Class{k});
+	}
+	side = nullptr;
+}
+
+
+// starts a block for online mode, to be allocated k registers
+// (nr) and written to os. nothing further ahead than window
+// instructions is known when an instruction is allocated, so
+// next uses beyond the window are FAR, values whose next use
+// is not known yet are never freed (until their register is
+// redefined, when their spill slot is freed too), so a dirty one
+// is stored when it is evicted even if it is dead (a long chain
+// of values each used once costs a store apiece), clean loads
+// are not found, and since the number of values live at once is
+// not known either, a register is always kept for spilling.
+void AllocationContext::start(ostream& os, int nr, int w) {
+	intRep.clear();
+	regNames.reset();
+	numRegs = nr;
+	threads = 1;
+	segmented = false;
+	pastCycles = 0;
+	numLanes = 1;
+	out = &os;
+	window = w;
+	fed = 0;
+	done = 0;
+
+	// window is a ring of instructions, indexed by index % size,
+	// that grows as they are fed in, up to window + 1 (see feedClass)
+	intRep.clear();
+	patches.reset();
+	vr2mem.clear();
+	clean.clear();
+	uses.clear();
+	sr2vr.clear();
+	lastRef.clear();
+	k = numRegs - 1;
+	held = INVALID;
+	maxLive = 0;
+	withClass([&] (auto& c) {
+		c.reset(k, 0);
+		c.spills = &patches;
+		c.slots.reset(SPILL);
+	});
+}
+
+
+// feeds instruction op with source operands s1, s2 and
+// d into the block started last (see feedClass)
+void AllocationContext::feed(Opcode op, int s1, int s2, int d) {
+	int s[] = {s1, s2, d};
+	withPolicy([&] (auto p) {
+		withClass([&] (auto& c) { feedClass<decltype(p)>(c, op, s); });
+	});
+}
+
+
+// allocates and writes out what is left of
+// the block started last (see finishClass)
+void AllocationContext::finish() {
+	withPolicy([&] (auto p) {
+		withClass([&] (auto& c) { finishClass<decltype(p)>(c); });
+	});
+}
+
+
+// sets victim selection policy to p. the policy a block
+// is allocated with is the one set when it was started.
+void AllocationContext::setPolicy(Policy p) {
+	policy = p;
+}
+
+
+// returns estimated cycles taken by the allocated code:
+// the latencies of its operations, spill code included
+long AllocationContext::cycles() const {
+	long n = pastCycles;
+	for (int i = 0; i < intRep.size(); ++i)
+		n += opInfo[intRep.op[i]].latency;
+	for (int j = 0; j < patches.size(); ++j)
+		n += opInfo[patches[j].op].latency;
+	return n;
 }
 
 
-// allocates and assigns k physical
-// registers to the virtual registers
-void Allocator::assignRegisters(Class c) {
-	auto it = intRep.begin();
-	while (it != intRep.end()) {
-		
+// returns number of lanes the last allocation used
+// (1 unless it was in segmented mode)
+int AllocationContext::lanes() const {
+	return numLanes;
+}
+
+
+// returns number of spill slots the last allocation used
+// (its spill memory is 4 bytes a slot)
+int AllocationContext::spillSlots() const {
+	return numSlots;
+}
+
+
+// allocates numRegs registers to intRep: maps source registers
+// to virtual registers, computes next use (live range) of each
+// register, and tracks number of live registers in the process,
+// all from computeLastUses(); allocates and assigns physical
+// registers to live ranges (virtual registers).
+void AllocationContext::assignBlock() {
+	prepareBlock();
+	// allocate and assign physical registers, using
+	// the smallest class that holds k registers
+	withPolicy([&] (auto p) {
+		withClass([&] (auto& c) { assignClass<decltype(p)>(c); });
+	});
+	hoistRestores();
+}
+
+
+// helper for assignBlock(), assignClass() and optimize()
+// everything assignBlock does before allocating: live ranges
+// (computeLastUses) and k. in segmented mode a register is
+// reserved for spilling if there aren't enough; otherwise each
+// store claims one as it needs it (see allocate).
+void AllocationContext::prepareBlock() {
+	patches.reset();
+	vr2mem.clear();
+	clean.clear();
+	k = numRegs;
+	held = INVALID;
+	maxLive = 0;
+
+	computeLastUses(threads);
+	// if we don't have enough registers, reserve last
+	// register for spilling (lanes store values live out
+	// of them at their ends, where nothing can be claimed)
+	if (k < maxLive && segmented)
+		--k;
+}
+
+
+// helper for assignBlock(), optimize() and streamClass()
+// moves each load in patches (a restore, with the loadI of its
+// address if that goes into the register it loads) up the code,
+// as far as the registers it uses let it: to after the last
+// operation that uses the register it loads (which holds nothing
+// needed from there on) or its address, or the last store that
+// may write the memory it reads (any store, unless both addresses
+// are known constants, as spill addresses are). its latency then
+// overlaps the instructions it was moved over, instead of stalling
+// the instruction that needs its value. nothing is moved to right
+// behind a load into a register it uses, or a store it must follow,
+// where it would only wait for them instead. other loadIs stay, as
+// they take a cycle, so waiting on them costs nothing (where they
+// are they may even fill a stall); so do stores. allocation is
+// done, so nothing more is spilled. (online mode writes code out
+// as it goes, so its patches stay where allocate() put them.)
+// if carry is set, intRep follows the code hoisted last (the
+// chunk before, in stream mode), and what is known of that carries
+// over, at positions before the first; nothing moves above it.
+void AllocationContext::hoistRestores(bool carry) {
+	// (positions before the first are -1 and less; nothing waits
+	// on -1 for a use, or -3 for a load or store)
+	if (carry) {
+		int n = follows.size();
+		for (int i = 0; i < numRegs; ++i) {
+			touched[i] = max(touched[i] - n, -1);
+			loaded[i] = max(loaded[i] - n, -3);
+		}
+		for (auto it = storedTo.begin(); it != storedTo.end(); ) {
+			if (it->second - n > -3) {
+				it->second -= n;
+				++it;
+			} else
+				it = storedTo.erase(it);
+		}
+		lastStore = max(lastStore - n, -3);
+		lastUnknown = max(lastUnknown - n, -3);
+	} else {
+		touched.assign(numRegs, -1);
+		loaded.assign(numRegs, -3);
+		contents.assign(numRegs, INVALID);
+		storedTo.clear();
+		lastStore = -3;
+		lastUnknown = -3;
+	}
+	follows.clear();
+	hoisted.clear();
+	moved.assign(patches.size(), false);
+	int j = 0;
+	for (int i = 0; i < intRep.size(); ++i) {
+		for (; j < patches.size() && patches[j].at == i; ++j) {
+			int pos = follows.size();
+			follows.push_back(i);
+			const Patch& p = patches[j];
+			int d = p.pr[destSlot];
+			int a = p.pr[src1Slot];
+			if (p.op == store) {
+				int t = p.pr[src2Slot];
+				touched[a] = touched[t] = pos;
+				lastStore = pos;
+				if (knownAddress(contents[t]))
+					storedTo[contents[t]] = pos;
+				else
+					lastUnknown = pos;
+				continue;
+			}
+			// the address of a restore goes with it
+			bool pair = p.op == loadI && j + 1 < patches.size()
+						&& patches[j+1].at == i && patches[j+1].op == load
+						&& patches[j+1].pr[src1Slot] == d
+						&& patches[j+1].pr[destSlot] == d;
+			if (p.op == loadI && !pair) {
+				touched[d] = pos;
+				contents[d] = p.c;
+				continue;
+			}
+			if (pair)
+				a = d;
+			int addr = pair ? p.c : contents[a];
+			int st = lastStore;
+			if (knownAddress(addr)) {
+				auto it = storedTo.find(addr);
+				st = max(lastUnknown, it != storedTo.end() ? it->second : -3);
+			}
+			int to = max({touched[d], loaded[d] + 2, st + 2});
+			if (!pair)
+				to = max({to, touched[a], loaded[a] + 2});
+			if (to < pos - 1) {
+				hoisted.push_back(pii(to, j));
+				moved[j] = true;
+			} else
+				to = pos;
+			if (pair) {
+				// (the load is at the position after its address)
+				++j;
+				follows.push_back(i);
+				if (to < pos) {
+					hoisted.push_back(pii(to, j));
+					moved[j] = true;
+				}
+			}
+			touched[d] = to;
+			touched[a] = to;
+			loaded[d] = to;
+			contents[d] = INVALID;
+		}
+		int pos = follows.size();
+		follows.push_back(i + 1);
+		const int* pr = &intRep.pr[3*i];
+		for (int slot : {src1Slot, src2Slot, destSlot})
+			if (intRep.isReg(i, slot))
+				touched[pr[slot]] = pos;
+		if (intRep.op[i] == store) {
+			lastStore = pos;
+			if (knownAddress(contents[pr[src2Slot]]))
+				storedTo[contents[pr[src2Slot]]] = pos;
+			else
+				lastUnknown = pos;
+		}
+		if (intRep.op[i] == load)
+			loaded[pr[destSlot]] = pos;
+		if (intRep.isReg(i, destSlot))
+			contents[pr[destSlot]] = intRep.op[i] == loadI
+										? intRep.sr[3*i + src1Slot] : INVALID;
+	}
+	if (hoisted.empty())
+		return;
+
+	// merge them back in order (those moved after the same
+	// position stay in the order they were in), each in front of
+	// the instruction after where it was moved. (patch j is at
+	// position j + at, as at instructions come before it.)
+	stable_sort(hoisted.begin(), hoisted.end(),
+				[] (pii x, pii y) { return x.first < y.first; });
+	spare.reset();
+	size_t h = 0;
+	for (int m = 0; m <= patches.size(); ++m) {
+		if (m < patches.size() && moved[m])
+			continue;
+		int before = m < patches.size() ? m + patches[m].at : INT_MAX;
+		for (; h < hoisted.size() && hoisted[h].first < before; ++h) {
+			int to = hoisted[h].first;
+			const Patch& p = patches[hoisted[h].second];
+			spare.add(to < 0 ? 0 : follows[to], p.op, p.c, p.pr[src1Slot],
+											p.pr[src2Slot], p.pr[destSlot]);
+		}
+		if (m < patches.size()) {
+			const Patch& p = patches[m];
+			spare.add(p.at, p.op, p.c, p.pr[src1Slot], p.pr[src2Slot],
+															p.pr[destSlot]);
+		}
+	}
+	patches.swap(spare);
+}
+
+
+// helper for hoistRestores() and timedCycles()
+// indicates addr (the constant in a register, or INVALID) is an
+// address a load or store is known to use: a word on its own,
+// which no access through another such address overlaps
+static bool knownAddress(int addr) {
+	return addr >= 0 && addr % 4 == 0;
+}
+
+
+// allocates intRep using class c, or (in segmented mode, if
+// the block is large enough to split) copies of it, one per lane.
+// lanes are allocated on threads of their own, and their spill
+// code goes into patches in order once they are all done.
+// victims are picked by policy P.
+// if a store found no register to claim for its address (every
+// register it could take held a dirty value), the block is
+// allocated again with the last register reserved for that.
+template <class P, class C>
+void AllocationContext::assignClass(C& c) {
+	if (!segmented || !findLanes()) {
+		numLanes = 1;
+		while (true) {
+			c.reset(k, vr2mem.size());
+			c.spills = &patches;
+			c.slots.reset(SPILL);
+			if (P::countsUses) {
+				uses.assign(vr2mem.size(), 0);
+				countUses(0, intRep.size());
+			}
+			held = INVALID;
+			stuck = false;
+			assignRegisters<P>(c, 0, intRep.size());
+			numSlots = c.slots.size();
+			if (!stuck)
+				return;
+			prepareBlock();
+			--k;
+		}
+	}
+
+	// each lane counts the uses of its own vrs (see assignLane)
+	if (P::countsUses)
+		uses.assign(vr2mem.size(), 0);
+
+	vector<C> cs (numLanes);
+	vector<thread> workers;
+	for (int m = 1; m < numLanes; ++m) {
+		const Lane* next = m + 1 < numLanes ? laneList[m+1].get() : nullptr;
+		workers.push_back(thread {&AllocationContext::assignLane<P, C>, this,
+							ref(*laneList[m]), ref(cs[m]), next});
+	}
+	assignLane<P>(*laneList[0], cs[0], laneList[1].get());
+	for (thread& t : workers)
+		t.join();
+
+	// (values live from lane to lane have slots of their own)
+	numSlots = (laneList[0]->firstAddr - SPILL) / 4;
+	for (int m = 0; m < numLanes; ++m) {
+		numSlots += cs[m].slots.size();
+		const PatchList& pl = laneList[m]->patches;
+		for (int j = 0; j < pl.size(); ++j)
+			patches.add(pl[j].at, pl[j].op, pl[j].c,
+						pl[j].pr[src1Slot], pl[j].pr[src2Slot], pl[j].pr[destSlot]);
+	}
+}
+
+
+// splits intRep into lanes (segmented mode): one per thread,
+// no smaller than LANE_MIN instructions, each starting at the
+// point near its share of the block where the fewest values are
+// live (fewer than k, so a register is left to hold the address
+// of each store at the end of the lane before it).
+// gives each value live into a lane its copy there, and each
+// dirty value live out of the lane that defines it a spill
+// address, so lanes share nothing they write to.
+// returns false if the block is not split.
+bool AllocationContext::findLanes() {
+	int n = intRep.size();
+	int want = threads > 0 ? threads : thread::hardware_concurrency();
+	want = min(want, n / LANE_MIN);
+	if (want < 2)
+		return false;
+
+	// liveAt[i]: values live from before instruction i into it
+	// (a value is live from each reference to its next use)
+	liveAt.assign(n + 1, 0);
+	for (int op = 0; op < 3 * n; ++op) {
+		int i = op / 3;
+		int nu = intRep.nu[op];
+		if (intRep.isReg(i, op % 3) && nu != INT_MAX && nu > i) {
+			++liveAt[i + 1];
+			--liveAt[nu + 1];
+		}
+	}
+	for (int i = 1; i <= n; ++i)
+		liveAt[i] += liveAt[i - 1];
+
+	// cut near each share, where fewest values are live
+	vector<int> cuts {0};
+	int reach = n / (4 * want);
+	for (int j = 1; j < want; ++j) {
+		int pos = (long)n * j / want;
+		int best = INVALID;
+		for (int b = max(cuts.back() + 1, pos - reach);
+								b <= min(n - 1, pos + reach); ++b)
+			if (liveAt[b] < k && (best == INVALID || liveAt[b] < liveAt[best]))
+				best = b;
+		if (best != INVALID)
+			cuts.push_back(best);
+	}
+	cuts.push_back(n);
+	numLanes = cuts.size() - 1;
+	if (numLanes < 2)
+		return false;
+	while ((int)laneList.size() < numLanes)
+		laneList.emplace_back(new Lane);
+	for (int m = 0; m < numLanes; ++m) {
+		Lane& l = *laneList[m];
+		l.begin = cuts[m];
+		l.end = cuts[m + 1];
+		l.patches.reset();
+		l.liveIn.clear();
+	}
+
+	defined.assign(vr2mem.size(), false);
+	for (int i = 0; i < n; ++i)
+		if (intRep.isReg(i, destSlot))
+			defined[intRep.vr[3*i + destSlot]] = true;
+
+	// copies of values live into each lane, and spill
+	// addresses of those stored at the end of a lane
+	int nextAddr = SPILL;
+	vector<int> operands (numLanes, 0);
+	for (int op = 0, m = 0; op < 3 * n; ++op) {
+		int i = op / 3;
+		int nu = intRep.nu[op];
+		if (!intRep.isReg(i, op % 3))
+			continue;
+		if (i >= cuts[m + 1])
+			++m;
+		++operands[m];
+		if (nu == INT_MAX || nu <= i)
+			continue;
+		int vr = intRep.vr[op];
+		for (int j = m + 1; j < numLanes && cuts[j] <= nu; ++j) {
+			if (clean[vr] == dirty && defined[vr] && vr2mem[vr] == INVALID) {
+				vr2mem[vr] = nextAddr;
+				nextAddr += 4;
+			}
+			Clean cln = clean[vr] == dirty && defined[vr] ? spilled : clean[vr];
+			int addr = vr2mem[vr];
+			laneList[j]->liveIn.push_back(pii(vr, vr2mem.size()));
+			clean.push_back(cln);
+			vr2mem.push_back(addr);
+		}
+	}
+	// each lane spills each of its vrs at most once, so
+	// its number of operands bounds its spill addresses
+	for (int m = 0; m < numLanes; ++m) {
+		laneList[m]->firstAddr = nextAddr;
+		nextAddr += 4 * operands[m];
+	}
+	return true;
+}
+
+
+// allocates lane l using class c (on its own thread): renames
+// values live into l to their copies, allocates l, and then
+// stores the values live out of l (into next) that l defined
+// and still holds only in registers, in front of next.
+// the address of each store goes into the scratch register,
+// or one that holds no value to be stored if there is none.
+// every vr used in l is defined in l or is a copy of l's own,
+// so lanes count their uses without getting in each other's way.
+template <class P, class C>
+void AllocationContext::assignLane(Lane& l, C& c, const Lane* next) {
+	if (l.rename.size() < defined.size())
+		l.rename.resize(defined.size(), INVALID);
+	for (pii p : l.liveIn)
+		l.rename[p.first] = p.second;
+	for (int op = 3 * l.begin; op < 3 * l.end; ++op)
+		if (intRep.isReg(op / 3, op % 3) && l.rename[intRep.vr[op]] != INVALID)
+			intRep.vr[op] = l.rename[intRep.vr[op]];
+
+	c.reset(k, vr2mem.size());
+	c.spills = &l.patches;
+	c.slots.reset(l.firstAddr);
+	if (P::countsUses)
+		countUses(l.begin, l.end);
+	assignRegisters<P>(c, l.begin, l.end);
+
+	if (next != nullptr) {
+		// registers holding values to be stored
+		vector<pii> stores;		// <pr, address>
+		vector<bool> storing (k, false);
+		for (pii p : next->liveIn) {
+			int vr = l.rename[p.first] != INVALID ? l.rename[p.first] : p.first;
+			if (clean[vr] == dirty && vr2mem[vr] != INVALID
+										&& c.vr2pr[vr] != INVALID) {
+				stores.push_back(pii(c.vr2pr[vr], vr2mem[vr]));
+				storing[c.vr2pr[vr]] = true;
+			}
+		}
+		int t = k;
+		if (k == numRegs)
+			t = find(storing.begin(), storing.end(), false) - storing.begin();
+		for (pii s : stores) {
+			l.patches.add(l.end, loadI, s.second, INVALID, INVALID, t);
+			l.patches.add(l.end, store, INVALID, s.first, t, INVALID);
+		}
+	}
+
+	for (pii p : l.liveIn)
+		l.rename[p.first] = INVALID;
+}
+
+
+// allocates and assigns k physical registers to the virtual
+// registers of instructions begin to end. physical registers
+// are recorded in intRep; spill code is added to c.spills, in
+// front of the instruction that needs it, so intRep keeps its shape.
+// victims are picked by policy P (see optimalPR).
+template <class P, class C>
+void AllocationContext::assignRegisters(C& c, int begin, int end) {
+	for (int i = begin; i < end; ++i) {
+		int* pr = &intRep.pr[3*i];
+		const int* vr = &intRep.vr[3*i];
+		const int* nu = &intRep.nu[3*i];
+
 		// assign "rx" -- ensure register is valid
-		if (it->src1.isReg)
-			it->src1.pr = ensure(it, it->src1.vr, c);
+		if (intRep.isReg(i, src1Slot))
+			pr[src1Slot] = ensure<P>(i, vr[src1Slot], c);
 		// assign "ry" -- ensure register is valid
-		if (it->src2.isReg)
-			it->src2.pr = ensure(it, it->src2.vr, c);
+		if (intRep.isReg(i, src2Slot))
+			pr[src2Slot] = ensure<P>(i, vr[src2Slot], c);
 
-		// free assigned pr's if not needed after this Instruction
+		// these uses are done with
+		if (P::countsUses) {
+			if (intRep.isReg(i, src1Slot))
+				--uses[vr[src1Slot]];
+			if (intRep.isReg(i, src2Slot))
+				--uses[vr[src2Slot]];
+		}
+
+		// free assigned pr's if not needed after this instruction
 		// nu will be INT_MAX if not used or INVALID for non-registers
 
 		// "rx"
-		if (it->src1.nu == INT_MAX)
-			freeRegister(it->src1.pr, c);
+		if (nu[src1Slot] == INT_MAX)
+			freeRegister(pr[src1Slot], c);
 		// "ry"
-		if (it->src2.isReg && it->src2.nu == INT_MAX)
-			freeRegister(it->src2.pr, c);
+		if (intRep.isReg(i, src2Slot) && nu[src2Slot] == INT_MAX)
+			freeRegister(pr[src2Slot], c);
 
-		// keep assigned pr's if needed after this Instruction
+		// keep assigned pr's if needed after this instruction
 		// first ensure src1 has been assigned a pr
+		// ("ry" goes first: if both are the same vr, the next use
+		// of "rx" is the one after this instruction)
 
-		// "rx"
-		if (it->src1.pr != INVALID)
-			c.next[it->src1.pr] = it->src1.nu;
 		// "ry"
-		if (it->src2.pr != INVALID)
-			c.next[it->src2.pr] = it->src2.nu;
+		if (pr[src2Slot] != INVALID)
+			c.setNext(pr[src2Slot], nu[src2Slot]);
+		// "rx"
+		if (pr[src1Slot] != INVALID)
+			c.setNext(pr[src1Slot], nu[src1Slot]);
 
 		// assign "rz" -- ensure register is valid
-		if (it->dest.isReg) {
-			it->dest.pr = allocate(it, it->dest.vr, c);
-			c.next[it->dest.pr] = it->dest.nu;
+		if (intRep.isReg(i, destSlot)) {
+			pr[destSlot] = allocate<P>(i, vr[destSlot], c);
+			c.setNext(pr[destSlot], nu[destSlot]);
+			// (whatever spill code left in it is overwritten)
+			c.setKnown(pr[destSlot], intRep.op[i] == loadI
+									? intRep.sr[3*i + src1Slot] : INVALID);
 		}
 
-		++it;
+		// spill slots of sources not needed after this instruction
+		// can be given out again, once "rz" is assigned (keepSpare
+		// may restore a source whose register "rz" takes)
+		if (nu[src1Slot] == INT_MAX)
+			freeSlot(vr[src1Slot], c);
+		if (intRep.isReg(i, src2Slot) && nu[src2Slot] == INT_MAX
+										&& vr[src2Slot] != vr[src1Slot])
+			freeSlot(vr[src2Slot], c);
 	}
 }
 
@@ -102,313 +1069,1499 @@ void Allocator::assignRegisters(Class c) {
 // ensures a physical register has been allocated
 // to virtual register, allocating one if not.
 // returns physical register to be assigned to vr.
-int Allocator::ensure(lit& it, int vr, Class& c) {
-	int pr;
-	// if pr already allocated to vr, find and return it
-	auto found = find(c.name.begin(), c.name.end(), vr);
-	if (found != c.name.end())
-		pr = found - c.name.begin();
-	else {
+// restore code goes in front of instruction at.
+template <class P, class C>
+int AllocationContext::ensure(int at, int vr, C& c) {
+	// if pr already allocated to vr, return it
+	int pr = c.vr2pr[vr];
+	if (pr == INVALID) {
 	// otherwise, allocate one
-		pr = allocate(it, vr, c);
+		pr = allocate<P>(at, vr, c);
 		// and RESTORE
-		if (clean[vr] == remat) {
-			// construct loadI Instruction and insert into IR
-			// loadI vr2mem[vr] => pr
-			Instruction i {loadI};
-//			i.src1.sr = rematerializable[vr];
-			i.src1.sr = vr2mem[vr];
-			i.dest.isReg = true;
-			i.dest.pr = pr;
-			intRep.insert(it, i);
-//cerr << "ensure::remat::inserting::loadI " << i.src1.sr << " => " << i.dest.pr << endl;
-		} else if (vr2mem[vr] != INVALID) {
-//		} else if (clean[vr] != dirty) {
-//cerr << "restoring vr" << vr << endl;
-			// construct loadI Instruction and insert into IR
-			// loadI vr2mem[vr] => r0
-			Instruction i {loadI};
-			i.src1.sr = vr2mem[vr];
-			i.dest.isReg = true;
-			i.dest.pr = k;
-			intRep.insert(it, i);
-//cerr << "ensure::!dirty::inserting::loadI " << i.src1.sr << " => " << i.dest.pr << endl;
-			// construct load Instruction and insert into IR
-			// load r0 => pr
-			i = Instruction {load};
-			i.src1.isReg = true;
-			i.src1.pr = k;
-			i.dest.isReg = true;
-			i.dest.pr = pr;
-			intRep.insert(it, i);
-		}
+		restoreValue(at, vr, pr, c);
 	}
 	// return vr's pr
 	return pr;
 }
 
 
+// helper for ensure() and allocate()
+// adds code in front of instruction at that brings the value
+// of vr back into pr. the address goes into pr itself, so a
+// restore never needs a register for it, unless a register
+// holds it already (then no loadI is needed). a constant that
+// pr still holds is not loaded again.
+template <class C>
+void AllocationContext::restoreValue(int at, int vr, int pr, C& c) {
+	int addr = vr2mem[vr];
+	if (clean[vr] == remat) {
+		// loadI vr2mem[vr] => pr
+		if (addr == INVALID || c.known[pr] != addr) {
+			c.spills->add(at, loadI, addr, INVALID, INVALID, pr);
+			c.setKnown(pr, addr);
+		}
+	} else if (addr != INVALID) {
+		int t = c.holder(addr);
+		if (t == INVALID) {
+			// loadI vr2mem[vr] => pr
+			c.spills->add(at, loadI, addr, INVALID, INVALID, pr);
+			t = pr;
+		}
+		// load t => pr
+		c.spills->add(at, load, INVALID, t, INVALID, pr);
+		c.setKnown(pr, INVALID);
+	}
+}
+
+
+// helper for allocate()
+// adds code in front of instruction at that stores the value
+// in pr to its spill address (giving it one if it has none)
+// using t for the address, and marks the value clean.
+// t is only loaded if it does not hold the address already.
+template <class C>
+void AllocationContext::storeValue(int at, int pr, int t, C& c) {
+	int vr = c.name[pr];
+	// save address where vr's value is to be stored
+	// (unless findLanes gave it one already)
+	if (vr2mem[vr] == INVALID)
+		vr2mem[vr] = c.slots.take(vr);
+	// loadI vr2mem => t
+	if (c.known[t] != vr2mem[vr]) {
+		dropWrites(at, t, c);
+		c.spills->add(at, loadI, vr2mem[vr], INVALID, INVALID, t);
+		c.setKnown(t, vr2mem[vr]);
+	}
+	// store pr => t
+	c.spills->add(at, store, INVALID, pr, t, INVALID);
+	// mark as clean
+	clean[vr] = spilled;
+}
+
+
+// helper for storeValue()
+// removes the last spill code in front of instruction at if it
+// writes t (a source restored into t, before t was claimed for
+// an address), as t is about to be loaded before anything reads
+// it. the source is restored again after the store.
+template <class C>
+void AllocationContext::dropWrites(int at, int t, C& c) {
+	PatchList& p = *c.spills;
+	while (p.size() > 0 && p[p.size() - 1].at == at
+						&& p[p.size() - 1].pr[destSlot] == t)
+		p.pop();
+}
+
+
 // helper for assignRegisters() and ensure()
 // allocates a physical register to virtual
 // register, spilling it if already in use.
-int Allocator::allocate(lit& it, int vr, Class& c) {
+// spill code goes in front of instruction at.
+// a store uses a register that holds its address already, if
+// there is one. otherwise the address goes into the register
+// kept for spilling, if there is one (k < numRegs), or else into
+// one claimed just for the store (see scratchPR). if that evicted a
+// value, the register is held for the stores after it (there are
+// likely more, while every register is in use) until a register
+// is free again, when it is given back. otherwise it is free right
+// after the store (or, if it holds a source of at, restored).
+// if none can be claimed, stuck is set, and the code is wrong
+// (see assignClass). keepSpare makes sure one can be.
+// if P counts cycles, what evicting a value costs (evictCost,
+// its store now if it is dirty and its restore when next used)
+// is added to spillCycles as it is evicted.
+template <class P, class C>
+int AllocationContext::allocate(int at, int vr, C& c) {
 	int pr;
 	// if pr available, return one
-	if (!c.stk.empty()) {
-		pr = c.stk.top();
-		c.stk.pop();
+	// (and give back the one held, as one is free)
+	if (c.anyFree()) {
+		if (held != INVALID) {
+			freeRegister(held, c);
+			held = INVALID;
+		}
+		pr = c.popFree();
 	} else {
 	// otherwise, find pr that won't be
 	// used for longest, spill and return it
-//		auto maxNext = max_element(c.next.begin(), c.next.end());
-//		pr = maxNext - c.next.begin();
-		pr = optimalPR(c);
-		// SPILL
-		if (clean[c.name[pr]] == dirty) {
-//cerr << "spilling vr" << vr << endl;
-			// build and insert loadI Instruction
-			// loadI nextMemAddr => r0
-			Instruction i {loadI};
-			i.src1.sr = nextMemAddr;
-			i.dest.isReg = true;
-			i.dest.pr = k;
-			intRep.insert(it, i);
-//cerr << "allocate::inserting::loadI " << i.src1.sr << " => " << i.dest.pr << endl;
-			// save address where vr's value is to be stored
-			vr2mem[c.name[pr]] = nextMemAddr;
-			nextMemAddr += 4;
-			// build and insert store Instruction
-			// store pr => r0
-			i = Instruction {store};
-			i.src1.isReg = true;
-			i.src1.pr = pr;
-			i.src2.isReg = true;
-			i.src2.pr = k;
-			intRep.insert(it, i);
-			// mark as clean
-			clean[c.name[pr]] = spilled;
+		pr = optimalPR(P(), c, at);
+		if (P::countsCycles && c.next[pr] != INT_MAX)
+			spillCycles += evictCost(c.cclean[pr]);
+		// SPILL (unless the value is never used again)
+		int v = c.name[pr];
+		if (clean[v] == dirty && c.next[pr] != INT_MAX) {
+			if (vr2mem[v] == INVALID)
+				vr2mem[v] = c.slots.take(v);
+			// (a register may hold the address already)
+			int t = c.holder(vr2mem[v]);
+			bool claimed = false;
+			if (t == INVALID) {
+				t = k < numRegs ? k : held;
+				claimed = t == INVALID;
+			}
+			if (claimed)
+				t = scratchPR(c, at);
+			if (t == INVALID) {
+				stuck = true;
+				t = pr;
+			}
+			storeValue(at, pr, t, c);
+			if (claimed && t != pr) {
+				bool live = c.next[t] != INT_MAX;
+				if (P::countsCycles && live)
+					spillCycles += evictCost(c.cclean[t]);
+				if (isSource(c, at, t))
+					restoreValue(at, c.name[t], t, c);
+				else if (live)
+					holdRegister(t, c);
+				else
+					freeRegister(t, c);
+			}
 		}
 	}
 	// set Class values to indicate pr is in use
+	if (c.name[pr] != INVALID)
+		c.vr2pr[c.name[pr]] = INVALID;
 	c.name[pr] = vr;
-	c.next[pr] = INVALID;
-	c.free[pr] = false;
-	c.cclean[pr] = clean[vr];
+	c.vr2pr[vr] = pr;
+	c.setNext(pr, INVALID);
+	c.setClean(pr, clean[vr]);
+	if (k == numRegs && k < maxLive && held == INVALID && clean[vr] == dirty
+				&& intRep.isReg(at, destSlot)
+				&& intRep.vr[3*at + destSlot] == vr && c.numSpare() == 0)
+		keepSpare<P>(at, pr, c);
 	// return allocated pr
 	return pr;
 }
 
 
+// helper for allocate()
+// called when pr has just taken the last register a store could
+// claim for its address (see scratchPR) for the dirty value
+// instruction at defines: stores the dirty value used furthest
+// off, which stays where it is, clean, so that there is one
+// again. its address goes into pr, which at is about to
+// overwrite (unless a register holds it already). if at reads
+// pr too (its value was a source of at, evicted for the new one
+// or dying at at), the source is restored into pr after the
+// store, or if it is dirty, nothing is stored. (while a register
+// is held, stores need no other.)
+template <class P, class C>
+void AllocationContext::keepSpare(int at, int pr, C& c) {
+	int d = furthestDirty(c, pr);
+	if (d == INVALID || c.next[d] == INT_MAX)
+		return;
+	int addr = vr2mem[c.name[d]];
+	int t = addr == INVALID ? INVALID : c.holder(addr);
+	int src = INVALID;
+	if (t == INVALID) {
+		t = pr;
+		for (int slot : {src1Slot, src2Slot})
+			if (intRep.isReg(at, slot) && intRep.pr[3*at + slot] == pr)
+				src = intRep.vr[3*at + slot];
+		if (src != INVALID && clean[src] == dirty)
+			return;
+	}
+	storeValue(at, d, t, c);
+	c.setClean(d, spilled);
+	if (src != INVALID)
+		restoreValue(at, src, pr, c);
+	if (P::countsCycles) {
+		spillCycles += opInfo[loadI].latency + opInfo[store].latency;
+		if (src != INVALID)
+			spillCycles += evictCost(clean[src]);
+	}
+}
+
+
 // selects optimal physical register
 // to be overwritten and possibly spilled
-int Allocator::optimalPR(Class& c) {
+// (only called when every register is in use)
+// a register the instruction at uses (already given to its first
+// source) is used now, or has no next use yet (INVALID), so it
+// is never the one with max next use, unless it is the only
+// remat register.
+int AllocationContext::optimalPR(CleanFirstPolicy, Class& c, int at) {
 	int pr = INVALID;
+	long now = chunkBase + at;
 
 	// if ramaterializable values exist, pick the one with max next use
-	if (find(c.cclean.begin(), c.cclean.end(), remat) != c.cclean.end())
-		pr = bestOfType(c, remat);
-	// if clean registers exits, pick the one with max next use
-	else if (find_if(c.cclean.begin(), c.cclean.end(),
-			[](int i){ return i != dirty; }) != c.cclean.end())
-		pr = bestOfType(c, dirty, true);
+	// (ties go to the highest register), unless it is used now
+	if (c.numRemat > 0) {
+		pr = c.useHeaps ? c.remats.top() : bestOfType(c, remat);
+		if (c.next[pr] > now)
+			return pr;
+	}
+	// if clean registers exits, pick the register with max next use,
+	// clean or not (ties go to the highest register)
+	if (c.numClean > 0)
+		pr = c.useHeaps ? c.latest.top() : bestOfType(c, dirty, true);
 	// otherwise, pick register with max next use
+	// (ties go to the lowest register)
+	else if (c.useHeaps)
+		pr = c.latestLow.top();
 	else {
 		auto it = max_element(c.next.begin(), c.next.end());
 		pr = it - c.next.begin();
 	}
-		
 
 	return pr;
 }
 
 
+// selects optimal physical register for a MaskClass,
+// with the same choice as for a Class
+// (only called when every register is in use)
+template <int N>
+int AllocationContext::optimalPR(CleanFirstPolicy, MaskClass<N>& c, int at) {
+	int pr = INVALID;
+	int optNextUse = INVALID;
+
+	// if ramaterializable values exist, pick the one with max next use
+	// (ties go to the highest register), unless it is used now
+	if (c.remats) {
+		for (uint32_t m = c.remats; m; m &= m - 1) {
+			int i = __builtin_ctz(m);
+			if (c.next[i] >= optNextUse) {
+				pr = i;
+				optNextUse = c.next[i];
+			}
+		}
+		if (optNextUse > chunkBase + at)
+			return pr;
+		optNextUse = INVALID;
+	}
+	// if clean registers exits, pick the register with max next use,
+	// clean or not (ties go to the highest register)
+	if (c.cleans) {
+		for (int i = 0; i < c.sz; ++i)
+			if (c.next[i] >= optNextUse) {
+				pr = i;
+				optNextUse = c.next[i];
+			}
+	// otherwise, pick register with max next use
+	// (ties go to the lowest register)
+	} else {
+		for (int i = 0; i < c.sz; ++i)
+			if (c.next[i] > optNextUse) {
+				pr = i;
+				optNextUse = c.next[i];
+			}
+	}
+
+	return pr;
+}
+
+
+// selects physical register to be overwritten under the belady
+// policy: the one with max next use, whether it is clean or not
+// (ties go to the lowest register)
+// (only called when every register is in use)
+int AllocationContext::optimalPR(BeladyPolicy, Class& c, int at) {
+	if (c.useHeaps)
+		return c.latestLow.top();
+	auto it = max_element(c.next.begin(), c.next.end());
+	return it - c.next.begin();
+}
+
+
+// selects physical register for a MaskClass,
+// with the same choice as for a Class
+// (only called when every register is in use)
+template <int N>
+int AllocationContext::optimalPR(BeladyPolicy, MaskClass<N>& c, int at) {
+	int pr = INVALID;
+	int optNextUse = INVALID;
+	for (int i = 0; i < c.sz; ++i)
+		if (c.next[i] > optNextUse) {
+			pr = i;
+			optNextUse = c.next[i];
+		}
+	return pr;
+}
+
+
+// selects physical register to be overwritten under the use count
+// policy, from the same registers cleanFirst would pick among
+// (remat ones not used now if any, else all), but by how far off the next use
+// is over how many uses are left (plus one), so that a value used
+// over and over gives way to one that is used less often, even if
+// it is needed a little sooner. ties go as they do for cleanFirst.
+// at is an index in intRep, and chunkBase + at in the block.
+// (only called when every register is in use)
+template <class C>
+int AllocationContext::optimalPR(UseCountPolicy, C& c, int at) {
+	long now = chunkBase + at;
+	// compares next use distance over uses left of
+	// registers a and b (without dividing)
+	auto cmp = [&] (int a, int b) {
+		long x = (c.next[a] - now) * (uses[c.name[b]] + 1L);
+		long y = (c.next[b] - now) * (uses[c.name[a]] + 1L);
+		return x < y ? -1 : x > y;
+	};
+	int bestRemat = INVALID;	// best remat register
+	int best = INVALID;			// best register (ties to highest)
+	int bestLow = INVALID;		// best register (ties to lowest)
+	bool anyClean = false;
+	for (int i = 0; i < c.sz; ++i) {
+		if (c.cclean[i] == remat && c.next[i] > now
+						&& (bestRemat == INVALID || cmp(i, bestRemat) >= 0))
+			bestRemat = i;
+		if (best == INVALID || cmp(i, best) >= 0)
+			best = i;
+		if (bestLow == INVALID || cmp(i, bestLow) > 0)
+			bestLow = i;
+		anyClean |= c.cclean[i] != dirty;
+	}
+	if (bestRemat != INVALID)
+		return bestRemat;
+	return anyClean ? best : bestLow;
+}
+
+
+// cycles of the spill code needed to evict a value of Clean
+// type cln now and bring it back later: a loadI for a remat
+// value, a loadI and load for one that is in memory already,
+// and a loadI and store as well for a dirty one
+static int evictCost(Clean cln) {
+	int restore = opInfo[loadI].latency + opInfo[load].latency;
+	if (cln == remat)
+		return opInfo[loadI].latency;
+	if (cln == dirty)
+		return restore + opInfo[loadI].latency + opInfo[store].latency;
+	return restore;
+}
+
+
+// indicates evicting register a (whose spill code costs ca and
+// whose next use is da instructions off) is better than evicting
+// b (cb, db): a lower cost over distance (compared without
+// dividing), then a lower cost, then the higher register
+static bool cheaper(long ca, long da, int a, long cb, long db, int b) {
+	if (ca * db != cb * da)
+		return ca * db < cb * da;
+	if (ca != cb)
+		return ca < cb;
+	return a > b;
+}
+
+
+// returns x with its bits mixed (the finalizer of
+// splitmix64), so that sums of them make good hashes
+static uint64_t mix(uint64_t x) {
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+
+// selects physical register to be overwritten under the spill
+// cost policy: the one whose eviction costs least (evictCost) for
+// how far off its next use is, so a dirty value not needed for a
+// long while goes before a clean one needed next. the next uses
+// come from the use chain computeLastUses threads through nu.
+// a value never used again costs nothing (allocate() does not
+// store it), and registers the instruction at uses (used now, or
+// with no next use yet) are never picked.
+// at is an index in intRep, and chunkBase + at in the block.
+// (only called when every register is in use)
+template <class C>
+int AllocationContext::optimalPR(SpillCostPolicy, C& c, int at) {
+	long now = chunkBase + at;
+	int pr = INVALID;
+	long optCost = 0;
+	long optDist = 1;
+	for (int i = 0; i < c.sz; ++i) {
+		long dist = c.next[i] - now;
+		if (dist <= 0)
+			continue;
+		long cost = c.next[i] == INT_MAX ? 0 : evictCost(c.cclean[i]);
+		if (pr == INVALID || cheaper(cost, dist, i, optCost, optDist, pr)) {
+			pr = i;
+			optCost = cost;
+			optDist = dist;
+		}
+	}
+	return pr;
+}
+
+
+// selects physical register for a Class under the spill cost
+// policy, with the same choice as above. with heaps, the best
+// register of each Clean type is the top of its heap (the one
+// used furthest off), so only those three are compared.
+// (only called when every register is in use)
+int AllocationContext::optimalPR(SpillCostPolicy, Class& c, int at) {
+	if (!c.useHeaps)
+		return optimalPR<Class>(SpillCostPolicy(), c, at);
+	long now = chunkBase + at;
+	int pr = INVALID;
+	long optCost = 0;
+	long optDist = 1;
+	for (Clean cln : {remat, spilled, dirty}) {
+		RegisterHeap& h = c.typeHeap(cln);
+		if (h.empty())
+			continue;
+		int i = h.top();
+		long dist = c.next[i] - now;
+		if (dist <= 0)
+			continue;
+		long cost = c.next[i] == INT_MAX ? 0 : evictCost(cln);
+		if (pr == INVALID || cheaper(cost, dist, i, optCost, optDist, pr)) {
+			pr = i;
+			optCost = cost;
+			optDist = dist;
+		}
+	}
+	return pr;
+}
+
+
+// helper for allocate()
+// selects a register to hold the address of a store, when none
+// is kept for that: one whose value can be dropped, as it is
+// clean (restored when it is next used) or never used again,
+// picked as the spill cost policy would pick a victim. registers
+// the instruction at uses (its sources, and those with no next
+// use yet) are only picked if there is no other, and then only
+// a clean source (which is restored right after the store).
+// returns INVALID if there is none.
+template <class C>
+int AllocationContext::scratchPR(C& c, int at) {
+	long now = chunkBase + at;
+	int pr = INVALID;
+	long optCost = 0;
+	long optDist = 1;
+	for (int i = 0; i < c.sz; ++i) {
+		long dist = c.next[i] - now;
+		if (dist <= 0 || isSource(c, at, i)
+					|| (c.cclean[i] == dirty && c.next[i] != INT_MAX))
+			continue;
+		long cost = c.next[i] == INT_MAX ? 0 : evictCost(c.cclean[i]);
+		if (pr == INVALID || cheaper(cost, dist, i, optCost, optDist, pr)) {
+			pr = i;
+			optCost = cost;
+			optDist = dist;
+		}
+	}
+	return pr != INVALID ? pr : cleanSource(c, at);
+}
+
+
+// selects register to hold the address of a store for a Class,
+// with the same choice as above. with heaps, the best register
+// of each Clean type is the top of its heap once the sources of
+// at are taken out of it (they are put back after), and a dirty
+// one only if its value is never used again.
+int AllocationContext::scratchPR(Class& c, int at) {
+	if (!c.useHeaps)
+		return scratchPR<Class>(c, at);
+	long now = chunkBase + at;
+	int pr = INVALID;
+	long optCost = 0;
+	long optDist = 1;
+	for (Clean cln : {remat, spilled, dirty}) {
+		RegisterHeap& h = c.typeHeap(cln);
+		int out[2];
+		int n = 0;
+		while (!h.empty() && isSource(c, at, h.top())) {
+			out[n++] = h.top();
+			h.remove(out[n - 1]);
+		}
+		if (!h.empty()) {
+			int i = h.top();
+			long dist = c.next[i] - now;
+			long cost = c.next[i] == INT_MAX ? 0 : evictCost(cln);
+			if (dist > 0 && (cln != dirty || c.next[i] == INT_MAX)
+						&& (pr == INVALID
+							|| cheaper(cost, dist, i, optCost, optDist, pr))) {
+				pr = i;
+				optCost = cost;
+				optDist = dist;
+			}
+		}
+		while (n > 0)
+			h.push(out[--n]);
+	}
+	return pr != INVALID ? pr : cleanSource(c, at);
+}
+
+
+// helper for scratchPR()
+// returns the register of a source of instruction at whose
+// value is clean, or INVALID if there is none
+template <class C>
+int AllocationContext::cleanSource(C& c, int at) {
+	for (int slot : {src1Slot, src2Slot}) {
+		if (!intRep.isReg(at, slot))
+			continue;
+		int pr = c.vr2pr[intRep.vr[3*at + slot]];
+		if (pr != INVALID && c.cclean[pr] != dirty)
+			return pr;
+	}
+	return INVALID;
+}
+
+
+// helper for keepSpare()
+// returns the dirty register other than pr whose next use is
+// furthest off, or INVALID if there is none
+template <class C>
+int AllocationContext::furthestDirty(C& c, int pr) {
+	int d = INVALID;
+	for (int i = 0; i < c.sz; ++i)
+		if (i != pr && c.name[i] != INVALID && c.cclean[i] == dirty
+								&& (d == INVALID || c.next[i] >= c.next[d]))
+			d = i;
+	return d;
+}
+
+
+// returns the dirty register for a Class, as above. with heaps
+// it is the top of dirties (pr, just given a value, has no next
+// use yet, so it is only on top if it is all there is)
+int AllocationContext::furthestDirty(Class& c, int pr) {
+	if (!c.useHeaps)
+		return furthestDirty<Class>(c, pr);
+	if (c.dirties.empty() || c.dirties.top() == pr)
+		return INVALID;
+	return c.dirties.top();
+}
+
+
+// indicates pr holds a source of instruction at
+template <class C>
+bool AllocationContext::isSource(C& c, int at, int pr) {
+	const int* vr = &intRep.vr[3*at];
+	return c.name[pr] != INVALID
+		&& ((intRep.isReg(at, src1Slot) && vr[src1Slot] == c.name[pr])
+			|| (intRep.isReg(at, src2Slot) && vr[src2Slot] == c.name[pr]));
+}
+
+
+// selects physical register for optimize(): ranks the registers
+// that could go (those the instruction at doesn't use) as the
+// spill cost policy would, and takes the one at the rank the script
+// gives for this point (the best past its end). a value never used
+// again is always the best victim, so then there is no choice.
+// records the point in points, with what evicting the register
+// at each rank costs (a dirty value's store claims a register
+// too, whose value must be restored). spillCycles (see allocate
+// and keepSpare) is what the spill code made so far costs, and
+// will cost once the values evicted are restored, so it never
+// goes down as the allocation goes on. (it is charged as if no
+// address were in a register already, so the code may cost less.)
+// what the rest of the block costs depends only on the state at
+// the point: where it is, which values are in registers, which of
+// them are dirty and which the instruction uses, which register
+// is held for stores, which address each register (and the one
+// kept for spilling) holds, and which spill slot each value has
+// and which are free. so once a state has been reached more
+// cheaply (on another script, which is searched from there), the
+// allocation is cut off (spillCycles set to bound). the state is
+// hashed (64 bits) into seen, and only past the end of the
+// script, since the points before that are the same as on the
+// script it came from.
+// (only called when every register is in use)
+template <class C>
+int AllocationContext::optimalPR(SearchPolicy, C& c, int at) {
+	long now = chunkBase + at;
+	// a store claims a register for its address if none is kept
+	// or held (the same one whichever value is stored), whose value
+	// is restored later too
+	int s = k == numRegs && held == INVALID ? scratchPR(c, at) : INVALID;
+	int sCost = s == INVALID || c.next[s] == INT_MAX ? 0
+												: evictCost(c.cclean[s]);
+	auto costOf = [&] (int r) {
+		if (c.next[r] == INT_MAX)
+			return 0;
+		return evictCost(c.cclean[r]) + (c.cclean[r] == dirty ? sCost : 0);
+	};
+	int d = points.size();
+	if (spillCycles < bound && d >= (int)script.size()) {
+		uint64_t h = mix(now) + mix(~(uint64_t)held << 40) + c.slots.hash;
+		for (int i = 0; i < c.sz; ++i)
+			if (c.name[i] != INVALID)
+				h += mix(4L * c.name[i] + 2 * (c.cclean[i] == dirty)
+									+ (c.next[i] <= now));
+		for (int i = 0; i <= c.sz; ++i)
+			h += mix((uint64_t)(i + 1) << 48 ^ (uint32_t)c.known[i]);
+		auto it = seen.find(h);
+		if (it != seen.end() && it->second <= spillCycles)
+			spillCycles = bound;
+		else
+			seen[h] = spillCycles;
+	}
+	ranked.clear();
+	for (int i = 0; i < c.sz; ++i)
+		if (c.next[i] > now)
+			ranked.push_back(i);
+	sort(ranked.begin(), ranked.end(), [&] (int a, int b) {
+		return cheaper(costOf(a), c.next[a] - now, a,
+						costOf(b), c.next[b] - now, b);
+	});
+	// nothing after a cut is searched
+	if (spillCycles >= bound)
+		return ranked[0];
+	SearchPoint p;
+	p.before = spillCycles;
+	p.first = cost.size();
+	p.choices = costOf(ranked[0]) == 0 ? 1 : ranked.size();
+	for (int r = 0; r < p.choices; ++r)
+		cost.push_back(costOf(ranked[r]));
+	int r = d < (int)script.size() ? script[d] : 0;
+	points.push_back(p);
+	return ranked[r];
+}
+
+
 // returns physical register number
 // of register with maximum next use and is clean in the manner specified by ctype
-int Allocator::bestOfType(Class& c, Clean cln, bool n) {
+// (or of any register, if n is set)
+int AllocationContext::bestOfType(Class& c, Clean cln, bool n) {
 	int pr = INVALID;
 	int optNextUse = INVALID;
-//	int optUses = INT_MAX;
 	for (int i = 0; i < c.sz; ++i) {
-		if (((n && c.cclean[i] != cln) || c.cclean[i] == cln)
-									&& c.next[i] >= optNextUse) {
-//			&& c.next[i] >= optNextUse && uses[c.name[i]] <= optUses) {
-				pr = i;
-				optNextUse = c.next[i];
-//				optUses = uses[c.name[i]];
+		if ((n || c.cclean[i] == cln) && c.next[i] >= optNextUse) {
+			pr = i;
+			optNextUse = c.next[i];
 		}
 	}
 	return pr;
 }
 
 
+// counts the uses of each vr in instructions begin to end
+// into uses (for policies that count them)
+void AllocationContext::countUses(int begin, int end) {
+	for (int i = begin; i < end; ++i)
+		for (int slot = src1Slot; slot <= src2Slot; ++slot)
+			if (intRep.isReg(i, slot))
+				++uses[intRep.vr[3*i + slot]];
+}
+
+
 // frees a physical register
 // sets Class values for pr to defaults, pushes onto stack.
-void Allocator::freeRegister(int pr, Class& c) {
+template <class C>
+void AllocationContext::freeRegister(int pr, C& c) {
+	// (pr holds no vr if it was claimed for spill code)
+	if (c.name[pr] != INVALID)
+		c.vr2pr[c.name[pr]] = INVALID;
 	c.name[pr] = INVALID;
-	c.next[pr] = INT_MAX;
-	c.free[pr] = true;
-	c.cclean[pr] = dirty;
-	c.stk.push(pr);
+	c.setNext(pr, INT_MAX);
+	c.setClean(pr, dirty);
+	c.pushFree(pr);
+}
+
+
+// frees the spill slot of vr, which is done with, if it has one
+// (it is spilled, but not rematerializable or a clean load,
+// whose addresses are not slots)
+template <class C>
+void AllocationContext::freeSlot(int vr, C& c) {
+	if (clean[vr] == spilled)
+		c.slots.give(vr2mem[vr], vr);
+}
+
+
+// helper for allocate()
+// keeps pr, whose value is dropped, for the address of the stores
+// to come: not free, and never a victim, as it has no next use
+// yet (like a register given to a source of the instruction)
+template <class C>
+void AllocationContext::holdRegister(int pr, C& c) {
+	c.vr2pr[c.name[pr]] = INVALID;
+	c.name[pr] = INVALID;
+	c.setNext(pr, INVALID);
+	c.setClean(pr, dirty);
+	held = pr;
 }
 
 
 // compute live ranges of source registers, map
 // each to distinct virtual register, set its
 // next use, and track the number of live registers.
-void Allocator::computeLastUses() {
+// large blocks are split into segments (no smaller than
+// LIVE_MIN instructions), one per thread, which number
+// everything exactly as a single pass would have.
+void AllocationContext::computeLastUses(int threads) {
 	// initialize vectors (only used here and update)
-	int numSR = getNumSR();
-	vector<int> sr2vr (numSR, INVALID);
-	vector<int> lastUse (numSR, INT_MAX);
+	// sr were renumbered densely by the Parser
+	int numSR = regNames.size();
+	sr2vr.assign(numSR, INVALID);
+	lastUse.assign(numSR, INT_MAX);
 
 	// for optimizations
-	vector<pii> stores;	// first: src2.vr, second: address (value in src2.vr)
-	// stores: [<dest vr, dest address>]
-	// when encounter a store instruction, insert with its destination vr
-	// when encounter loadI, check stores to find matching vr and save
-	// address with the pair
-	vector<pii> loads;	// first: src1.vr, second: dest.vr
-	// loads: [<src vr, dest vr>]
-	// when encounter a load, insert its vrs
-	// when encounter loadI, check loads to find matching vr, grab its
-	// addess, then see if we already encountered a store that overwrites
+	storedThrough.clear();
+	loadedThrough.clear();
+	storeAddrs.assign(max<size_t>(16, storeAddrs.size()), INVALID);
+	numStoreAddrs = 0;
+	// storedThrough: indexed by the address vr of a store
+	// when encounter a store instruction, mark its destination vr
+	// when encounter the definition of a marked vr, it is loadI
+	// (remember its constant as a stored address) or the address
+	// can't be known (forget it)
+	// loadedThrough: indexed by the address vr of a load
+	// when encounter a load, save its dest vr under its source vr
+	// when encounter loadI, grab the load saved under its vr,
+	// then see if we already encountered a store that overwrites
 	// the load address. if not, the load is clean!
+	// (each vr is defined once, so only the first store and load
+	// seen through it matter, and everything is O(1) per instruction)
+
+	if (threads <= 0)
+		threads = thread::hardware_concurrency();
+	int n = min(threads, intRep.size() / LIVE_MIN);
+	if (n > 1) {
+		// find segments
+		segs.resize(n);
+		for (int j = 0; j < n; ++j) {
+			segs[j].begin = (long)intRep.size() * j / n;
+			segs[j].end = (long)intRep.size() * (j + 1) / n;
+		}
+		// local live ranges of each segment (the last on this thread)
+		vector<thread> workers;
+		for (int j = 0; j < n - 1; ++j)
+			workers.push_back(thread {&AllocationContext::liveSegment,
+												this, ref(segs[j])});
+		liveSegment(segs[n-1]);
+		for (thread& t : workers)
+			t.join();
+		// join them up, from the end
+		int numVRs = joinSegments();
+		// and number them globally
+		workers.clear();
+		for (int j = 0; j < n - 1; ++j)
+			workers.push_back(thread {&AllocationContext::renameSegment,
+												this, ref(segs[j])});
+		renameSegment(segs[n-1]);
+		for (thread& t : workers)
+			t.join();
+		for (int j = 0; j < n; ++j)
+			maxLive = max(maxLive, segs[j].maxLive);
+		// clean analysis is one more (cheap) pass
+		vr2mem.assign(numVRs, INVALID);
+		clean.assign(numVRs, dirty);
+		storedThrough.assign(numVRs, false);
+		loadedThrough.assign(numVRs, INVALID);
+		for (int i = intRep.size() - 1; i >= 0; --i)
+			markClean(i);
+		return;
+	}
 
 	int vrName = 0;
 	int numLive = 0;
-	int i = intRep.size();
-	auto it = intRep.end();
-	while (it != intRep.begin()) {
-		--i;
-		--it;
+	for (int i = intRep.size() - 1; i >= 0; --i) {
+		const int* sr = &intRep.sr[3*i];
 		// update and kill
-		if (it->dest.isReg) {
-			update(it->dest, i, vrName, numLive, sr2vr, lastUse);
-			sr2vr[it->dest.sr] = INVALID;
-			lastUse[it->dest.sr] = INT_MAX;
+		if (intRep.isReg(i, destSlot)) {
+			update(3*i + destSlot, i, vrName, numLive);
+			sr2vr[sr[destSlot]] = INVALID;
+			lastUse[sr[destSlot]] = INT_MAX;
 			// track number of live registers
 			--numLive;
-			// track store addresses (for clean load optimization)
-			auto sit = find_if(stores.begin(), stores.end(),
-					[&] (pii& s) { return s.first == it->dest.vr; });
-			// if find a store that doesn't have an associated address
-			if (sit != stores.end() && sit->second == INVALID) {
-				if (it->op == loadI)
-					sit->second = it->src1.sr;
-				// if current instruction is not loadI, address was
-				// modified --> remove store from consideration
-				else
-					stores.erase(sit);
-			}
 		}
 		// update one use
-		if (it->src1.isReg)
-			update(it->src1, i, vrName, numLive, sr2vr, lastUse);
+		if (intRep.isReg(i, src1Slot))
+			update(3*i + src1Slot, i, vrName, numLive);
 		// and the other use
-		if (it->src2.isReg)
-			update(it->src2, i, vrName, numLive, sr2vr, lastUse);
-
-		// rematerializable optimization
-		if (it->op == loadI) {
-			clean[it->dest.vr] = remat;
-			vr2mem[it->dest.vr] = it->src1.sr;
-		}
-
-		//// clean loads optimization ////
-
-		// remember stores and loads
-		if (it->op == store)
-			stores.push_back(pii(it->src2.vr, INVALID));
-		if (it->op == load)
-			loads.push_back(pii(it->src1.vr, it->dest.vr));
-
-		// when encounter loadI, check loads
-		if (it->op == loadI) {
-			int addr = it->src1.sr;
-			// check loads
-			for (auto lit = loads.begin(); lit != loads.end(); ++lit) {
-//cerr << "next lit" << endl;
-//			for (pii l : loads) {
-				if (lit->first == it->dest.vr) {
-//				if (l.first == it->dest.vr) {
-					auto sit = find_if(stores.begin(), stores.end(),
-								[&] (pii& s) { return s.second == addr; });
-					if (sit == stores.end()) {
-						clean[lit->second] = cleanLoad;
-						vr2mem[lit->second] = addr;
-						loads.erase(lit);
-						break;
-					}
-				}
-			}
-		}
-
-	}
+		if (intRep.isReg(i, src2Slot))
+			update(3*i + src2Slot, i, vrName, numLive);
 
-/*
-	// mark loads as clean if no store overrides
-	for (auto l : loads) {
-		auto sit = find_if(stores.begin(), stores.end(),
-					[&] (pii& s) { return s.second == vr2mem[l.first]; });
-		if (sit == stores.end()) {
-			clean[l.second] = cleanLoad;
-			vr2mem[l.second] = vr2mem[l.first];
-		}
+		markClean(i);
 	}
-*/
-
 }
 
 
 // helper function for computeLastUses()
-// updates a Register by setting its virtual register and next use.
-// updates vectors used to track live ranges and their last use.
-void Allocator::update(Register& op, int ind, int& vrName, int& numLive,
-								vector<int>& sr2vr, vector<int>& lastUse) {
+// updates operand op (index into intRep's operand arrays) of
+// instruction ind by setting its virtual register and next use.
+// updates sr2vr and lastUse, which track live ranges and their last use.
+void AllocationContext::update(int op, int ind, int& vrName, int& numLive) {
+	int sr = intRep.sr[op];
 	// if not in use, update sr2vr to next vr
-	if (sr2vr[op.sr] == INVALID) {
-		sr2vr[op.sr] = vrName++;
+	if (sr2vr[sr] == INVALID) {
+		sr2vr[sr] = vrName++;
 		// track number of live registers
 		++numLive;
 		if (numLive > maxLive)
 			maxLive = numLive;
 		// add live range to vectors
 		vr2mem.push_back(INVALID);
-//		uses.push_back(0);
 		clean.push_back(dirty);
+		storedThrough.push_back(false);
+		loadedThrough.push_back(INVALID);
 	}
-	// map Register sr to vr
-	op.vr = sr2vr[op.sr];
-	// set Register nextUse
-	op.nu = lastUse[op.sr];
+	// map operand sr to vr
+	intRep.vr[op] = sr2vr[sr];
+	// set operand nextUse
+	intRep.nu[op] = lastUse[sr];
 	// update last use of vr to now
-	lastUse[op.sr] = ind;
-	// increment uses
-//	++uses[op.vr];
+	lastUse[sr] = ind;
+}
+
+
+// helper function for computeLastUses()
+// finds live ranges of segment s on its own, as if nothing were
+// live after it: sets local vr of each operand (in intRep), its
+// next use (INT_MAX where a local vr is made), and which operands
+// name each sr first and last (from the end of s).
+void AllocationContext::liveSegment(Segment& s) {
+	int numSR = regNames.size();
+	s.sr2vr.assign(numSR, INVALID);
+	s.lastUse.assign(numSR, INT_MAX);
+	s.lastRef.assign(numSR, INVALID);
+	s.exposed.clear();
+	s.upward.clear();
+	s.numVRs = 0;
+
+	// same as the single pass, but with local state
+	auto ref = [&] (int op, int ind) {
+		int sr = intRep.sr[op];
+		if (s.lastRef[sr] == INVALID)
+			s.exposed.push_back(op);
+		s.lastRef[sr] = op;
+		if (s.sr2vr[sr] == INVALID)
+			s.sr2vr[sr] = s.numVRs++;
+		intRep.vr[op] = s.sr2vr[sr];
+		intRep.nu[op] = s.lastUse[sr];
+		s.lastUse[sr] = ind;
+	};
+	for (int i = s.end - 1; i >= s.begin; --i) {
+		if (intRep.isReg(i, destSlot)) {
+			ref(3*i + destSlot, i);
+			s.sr2vr[intRep.sr[3*i + destSlot]] = INVALID;
+			s.lastUse[intRep.sr[3*i + destSlot]] = INT_MAX;
+		}
+		if (intRep.isReg(i, src1Slot))
+			ref(3*i + src1Slot, i);
+		if (intRep.isReg(i, src2Slot))
+			ref(3*i + src2Slot, i);
+	}
+	for (int op : s.exposed)
+		s.upward.push_back(s.lastRef[intRep.sr[op]]);
+}
+
+
+// helper function for computeLastUses()
+// goes through segments from the last, keeping sr2vr and lastUse
+// for the boundary between segments as the single pass would
+// have them there. a local vr made where its sr is first named
+// (from the end of its segment) is the global vr live out of the
+// segment, if there is one, and takes its next use; all others
+// are new, and are numbered in the order they were made.
+// returns the number of (global) vrs.
+int AllocationContext::joinSegments() {
+	int numSR = regNames.size();
+	sr2vr.assign(numSR, INVALID);
+	lastUse.assign(numSR, INT_MAX);
+	int base = 0;
+	int numLive = 0;
+	for (int j = segs.size() - 1; j >= 0; --j) {
+		Segment& s = segs[j];
+		s.base = base;
+		s.liveOut = numLive;
+		s.reused.clear();
+		for (int op : s.exposed) {
+			int sr = intRep.sr[op];
+			if (sr2vr[sr] != INVALID) {
+				s.reused.push_back(pii(intRep.vr[op], sr2vr[sr]));
+				intRep.nu[op] = lastUse[sr];
+			}
+		}
+		base += s.numVRs - s.reused.size();
+		// sr first named (from the start of segment) by a use are
+		// live into it; those first named by a definition are not
+		for (int op : s.upward) {
+			int sr = intRep.sr[op];
+			if (op % 3 == destSlot) {
+				if (sr2vr[sr] != INVALID)
+					--numLive;
+				sr2vr[sr] = INVALID;
+				lastUse[sr] = INT_MAX;
+				continue;
+			}
+			// global vr of local vr (reused are sorted by local vr)
+			int v = intRep.vr[op];
+			auto it = lower_bound(s.reused.begin(), s.reused.end(),
+															pii(v, INT_MIN));
+			if (it != s.reused.end() && it->first == v)
+				v = it->second;
+			else
+				v = s.base + v - (it - s.reused.begin());
+			if (sr2vr[sr] == INVALID)
+				++numLive;
+			sr2vr[sr] = v;
+			lastUse[sr] = op / 3;
+		}
+	}
+	return base;
+}
+
+
+// helper function for computeLastUses()
+// replaces local vrs of segment s by global ones, and tracks
+// the number of live registers through s as the single pass
+// would have (a vr is made where its next use is INT_MAX).
+void AllocationContext::renameSegment(Segment& s) {
+	s.map.resize(s.numVRs);
+	auto rit = s.reused.begin();
+	for (int v = 0, next = s.base; v < s.numVRs; ++v) {
+		if (rit != s.reused.end() && rit->first == v)
+			s.map[v] = (rit++)->second;
+		else
+			s.map[v] = next++;
+	}
+
+	int numLive = s.liveOut;
+	s.maxLive = 0;
+	auto ref = [&] (int op) {
+		if (intRep.nu[op] == INT_MAX && ++numLive > s.maxLive)
+			s.maxLive = numLive;
+		intRep.vr[op] = s.map[intRep.vr[op]];
+	};
+	for (int i = s.end - 1; i >= s.begin; --i) {
+		if (intRep.isReg(i, destSlot)) {
+			ref(3*i + destSlot);
+			--numLive;
+		}
+		if (intRep.isReg(i, src1Slot))
+			ref(3*i + src1Slot);
+		if (intRep.isReg(i, src2Slot))
+			ref(3*i + src2Slot);
+	}
+}
+
+
+// helper function for computeLastUses()
+// clean analysis of instruction i, once its operands have
+// virtual registers (instructions are visited from the end):
+// rematerializable values, and loads that are clean because
+// nothing after them stores to their address.
+void AllocationContext::markClean(int i) {
+	Opcode op = intRep.op[i];
+	const int* sr = &intRep.sr[3*i];
+	const int* vr = &intRep.vr[3*i];
+
+	// track store addresses (for clean load optimization)
+	// if a store is waiting for this address, it is known
+	// only if current instruction is loadI
+	if (intRep.isReg(i, destSlot) && storedThrough[vr[destSlot]]) {
+		storedThrough[vr[destSlot]] = false;
+		if (op == loadI)
+			addStoreAddr(sr[src1Slot]);
+	}
+
+	// rematerializable optimization
+	if (op == loadI) {
+		clean[vr[destSlot]] = remat;
+		vr2mem[vr[destSlot]] = sr[src1Slot];
+	}
+
+	//// clean loads optimization ////
+
+	// remember stores and loads
+	if (op == store)
+		storedThrough[vr[src2Slot]] = true;
+	if (op == load && loadedThrough[vr[src1Slot]] == INVALID)
+		loadedThrough[vr[src1Slot]] = chunkBase + i;
+
+	// when encounter loadI, check loads
+	if (op == loadI) {
+		int addr = sr[src1Slot];
+		int ld = loadedThrough[vr[destSlot]];
+		if (ld != INVALID && !isStoreAddr(addr))
+			markCleanLoad(ld, addr);
+	}
+}
+
+
+// helper for markClean()
+// marks value loaded by instruction ld (index in block) as a
+// clean load from addr. in stream mode, ld's vr may already be
+// reused (ld is after every instruction in intRep, or in it), so
+// its record is marked instead: in records if ld is in the chunk
+// being worked on, or on side if that chunk was written already.
+void AllocationContext::markCleanLoad(int ld, int addr) {
+	if (side == nullptr) {
+		int v = intRep.vr[3*ld + destSlot];
+		clean[v] = cleanLoad;
+		vr2mem[v] = addr;
+		return;
+	}
+	if (ld - chunkBase < (int)records.size()) {
+		records[ld - chunkBase].clean = cleanLoad;
+		records[ld - chunkBase].mem = addr;
+		return;
+	}
+	SideRecord r;
+	side->read(ld, &r, 1);
+	r.clean = cleanLoad;
+	r.mem = addr;
+	side->write(ld, &r, 1);
+}
+
+
+// computes next uses (stream mode) the way computeLastUses()
+// does on one thread, on chunks of side from the end. the vr of
+// a value is given back at its definition, to be reused by values
+// earlier in the block, so there are only as many vrs as are live
+// at once. since a vr may stand for several values, its Clean
+// type and address are written to the record of the instruction
+// that defines it, for streamClass() to pick up there.
+// returns the number of values live into the block.
+int AllocationContext::streamLastUses(long n, int chunk) {
+	int numSR = regNames.size();
+	sr2vr.assign(numSR, INVALID);
+	lastUse.assign(numSR, INT_MAX);
+	vr2mem.clear();
+	clean.clear();
+	uses.clear();
+	storedThrough.clear();
+	loadedThrough.clear();
+	storeAddrs.assign(max<size_t>(16, storeAddrs.size()), INVALID);
+	numStoreAddrs = 0;
+	freeVRs.clear();
+
+	// same as update(), but reusing vrs
+	int numLive = 0;
+	auto ref = [&] (int op, int ind) {
+		int sr = intRep.sr[op];
+		if (sr2vr[sr] == INVALID) {
+			if (freeVRs.empty()) {
+				sr2vr[sr] = vr2mem.size();
+				vr2mem.push_back(INVALID);
+				clean.push_back(dirty);
+				uses.push_back(0);
+				storedThrough.push_back(false);
+				loadedThrough.push_back(INVALID);
+			} else {
+				sr2vr[sr] = freeVRs.back();
+				freeVRs.pop_back();
+			}
+			if (++numLive > maxLive)
+				maxLive = numLive;
+		}
+		intRep.vr[op] = sr2vr[sr];
+		intRep.nu[op] = lastUse[sr];
+		lastUse[sr] = ind;
+	};
+
+	for (long first = (n - 1) / chunk * chunk; first >= 0; first -= chunk) {
+		readChunk(first, min<long>(chunk, n - first));
+		chunkBase = first;
+		for (int i = intRep.size() - 1; i >= 0; --i) {
+			const int* sr = &intRep.sr[3*i];
+			if (intRep.isReg(i, destSlot)) {
+				ref(3*i + destSlot, chunkBase + i);
+				sr2vr[sr[destSlot]] = INVALID;
+				lastUse[sr[destSlot]] = INT_MAX;
+				--numLive;
+			}
+			if (intRep.isReg(i, src1Slot)) {
+				ref(3*i + src1Slot, chunkBase + i);
+				++uses[intRep.vr[3*i + src1Slot]];
+			}
+			if (intRep.isReg(i, src2Slot)) {
+				ref(3*i + src2Slot, chunkBase + i);
+				++uses[intRep.vr[3*i + src2Slot]];
+			}
+
+			markClean(i);
+
+			// value defined here is done with its vr
+			if (intRep.isReg(i, destSlot)) {
+				int v = intRep.vr[3*i + destSlot];
+				records[i].clean = clean[v];
+				records[i].mem = vr2mem[v];
+				records[i].uses = uses[v];
+				clean[v] = dirty;
+				vr2mem[v] = INVALID;
+				uses[v] = 0;
+				storedThrough[v] = false;
+				loadedThrough[v] = INVALID;
+				freeVRs.push_back(v);
+			}
+		}
+		writeChunk(first);
+	}
+	chunkBase = 0;
+	return numLive;
+}
+
+
+// allocates block on side (stream mode) as assignClass() does
+// when not segmented, a chunk at a time from the start. each
+// instruction that defines a value sets its vr's Clean type,
+// address and uses (from its record) just before it is allocated.
+// uses of values live into the block are left from streamLastUses.
+// patches are at indices in the chunk, and go out with it, their
+// restores hoisted (see hoistRestores) no further than its start.
+// if a store finds no register for its address (see stream) in
+// the first chunk, nothing is written, so that stream() can
+// allocate the block again. after that, it ends alloc.
+// a value that is never used keeps its register until it is
+// picked to be spilled, so its vr must not be reused until then.
+// such values get one of k + 1 vrs of their own instead, the next
+// one (from dead) that no register holds; k registers can't hold
+// them all.
+template <class P, class C>
+void AllocationContext::streamClass(C& c, ostream& os, long n, int chunk) {
+	int numVRs = vr2mem.size();
+	c.reset(k, numVRs + k + 1);
+	c.spills = &patches;
+	c.slots.reset(SPILL);
+	// values live into the block are never defined
+	clean.assign(numVRs + k + 1, dirty);
+	vr2mem.assign(numVRs + k + 1, INVALID);
+	uses.resize(numVRs + k + 1, 0);
+	int dead = numVRs;
+
+	for (long first = 0; first < n; first += chunk) {
+		readChunk(first, min<long>(chunk, n - first));
+		chunkBase = first;
+		for (int i = 0; i < intRep.size(); ++i) {
+			if (intRep.isReg(i, destSlot)) {
+				int v = intRep.vr[3*i + destSlot];
+				if (intRep.nu[3*i + destSlot] == INT_MAX) {
+					while (c.vr2pr[dead] != INVALID)
+						dead = dead < numVRs + k ? dead + 1 : numVRs;
+					v = intRep.vr[3*i + destSlot] = dead;
+				}
+				clean[v] = (Clean)records[i].clean;
+				vr2mem[v] = records[i].mem;
+				uses[v] = records[i].uses;
+			}
+			assignRegisters<P>(c, i, i + 1);
+		}
+		if (stuck && first == 0) {
+			intRep.clear();
+			return;
+		}
+		if (stuck) {
+			cerr << "error: no register for a spill address in stream mode"
+																	<< endl;
+			exit(EXIT_FAILURE);
+		}
+		hoistRestores(first > 0);
+		emit(os);
+		pastCycles = cycles();
+		patches.reset();
+	}
+	numSlots = c.slots.size();
+	intRep.clear();
+	chunkBase = 0;
+}
+
+
+// reads n records of side, from record first, into
+// records, and their instructions (unallocated) into intRep
+void AllocationContext::readChunk(long first, int n) {
+	records.resize(n);
+	side->read(first, records.data(), n);
+	intRep.resize(n);
+	for (int i = 0; i < n; ++i) {
+		intRep.op[i] = (Opcode)records[i].op;
+		for (int slot = src1Slot; slot <= destSlot; ++slot) {
+			intRep.sr[3*i + slot] = records[i].sr[slot];
+			intRep.vr[3*i + slot] = records[i].vr[slot];
+			intRep.nu[3*i + slot] = records[i].nu[slot];
+			intRep.pr[3*i + slot] = INVALID;
+		}
+	}
+}
+
+
+// writes instructions of intRep to side, as records
+// first on (keeping Clean types and addresses in records)
+void AllocationContext::writeChunk(long first) {
+	int n = intRep.size();
+	records.resize(n);
+	for (int i = 0; i < n; ++i) {
+		records[i].op = intRep.op[i];
+		for (int slot = src1Slot; slot <= destSlot; ++slot) {
+			records[i].sr[slot] = intRep.sr[3*i + slot];
+			records[i].vr[slot] = intRep.vr[3*i + slot];
+			records[i].nu[slot] = intRep.nu[3*i + slot];
+		}
+	}
+	side->write(first, records.data(), n);
+}
+
+
+// calls f on the register class that holds k registers
+// (the same one assignBlock would allocate with)
+template <class F>
+void AllocationContext::withClass(F f) {
+	if (k <= 8)
+		f(regs8);
+	else if (k <= 16)
+		f(regs16);
+	else if (k <= MASK_REGS)
+		f(regs32);
+	else
+		f(regs);
+}
+
+
+// calls f on (a value of) the struct for policy
+template <class F>
+void AllocationContext::withPolicy(F f) {
+	if (policy == cleanFirst)
+		f(CleanFirstPolicy());
+	else if (policy == belady)
+		f(BeladyPolicy());
+	else if (policy == useCount)
+		f(UseCountPolicy());
+	else
+		f(SpillCostPolicy());
+}
+
+
+// helper for feed()
+// adds instruction op with source operands s to the window,
+// allocating the oldest instruction first if the window is
+// full. its operands are given vrs as computeLastUses would,
+// but forward: a use takes its register's current vr, and a
+// definition makes a new one. each reference settles the next
+// use of the one before it to the same register: the reference
+// itself, or INT_MAX if it is a definition. if that reference
+// was already allocated, it is its register that is settled
+// instead (given its next use, or freed).
+// a next use that is not settled in time is FAR, and the uses
+// left of a value are the ones in the window.
+template <class P, class C>
+void AllocationContext::feedClass(C& c, Opcode op, const int* s) {
+	int cap = intRep.size();
+	if (fed - done == cap && cap <= window)
+		intRep.resize(++cap);
+	else if (fed - done == cap)
+		allocateNext<P>(c);
+	int g = fed++;
+	int i = g % cap;
+	intRep.op[i] = op;
+	int* sr = &intRep.sr[3*i];
+	int* vr = &intRep.vr[3*i];
+	int* nu = &intRep.nu[3*i];
+	for (int slot = src1Slot; slot <= destSlot; ++slot) {
+		bool reg = intRep.isReg(i, slot);
+		sr[slot] = reg ? regNames.rename(s[slot]) : s[slot];
+		vr[slot] = INVALID;
+		nu[slot] = INVALID;
+		intRep.pr[3*i + slot] = INVALID;
+		if (reg && sr[slot] >= (int)sr2vr.size()) {
+			sr2vr.resize(sr[slot] + 1, INVALID);
+			lastRef.resize(sr[slot] + 1, INVALID);
+		}
+	}
+
+	// settles next use of last reference to sr r. if that was
+	// allocated already and r is redefined, its value is dead:
+	// its register (if it is still in one) and spill slot (if it
+	// was stored) are freed
+	auto settle = [&] (int r, int next) {
+		long ref = lastRef[r];
+		int at = ref / 3;
+		int v = sr2vr[r];
+		if (at >= done)
+			intRep.nu[3*(at % cap) + ref % 3] = next;
+		else if (next == INT_MAX) {
+			if (c.vr2pr[v] != INVALID)
+				freeRegister(c.vr2pr[v], c);
+			freeSlot(v, c);
+		} else if (c.vr2pr[v] != INVALID)
+			c.setNext(c.vr2pr[v], next);
+	};
+	// gives value in sr r a new vr (c has room for it)
+	auto define = [&] (int r, Clean cln, int mem) {
+		sr2vr[r] = vr2mem.size();
+		vr2mem.push_back(mem);
+		clean.push_back(cln);
+		uses.push_back(0);
+		if ((int)c.vr2pr.size() < sr2vr[r] + 1)
+			c.vr2pr.resize(2 * sr2vr[r] + 16, INVALID);
+	};
+
+	// uses (of an undefined value make a vr for it), "ry" first,
+	// so that if both are the same vr, "rx" is settled by the next
+	// use after this instruction (as computeLastUses does it)
+	for (int slot = src2Slot; slot >= src1Slot; --slot) {
+		if (!intRep.isReg(i, slot))
+			continue;
+		int r = sr[slot];
+		if (sr2vr[r] == INVALID)
+			define(r, dirty, INVALID);
+		else
+			settle(r, g);
+		vr[slot] = sr2vr[r];
+		nu[slot] = FAR;
+		lastRef[r] = 3L*g + slot;
+		++uses[vr[slot]];
+	}
+	// definition
+	if (intRep.isReg(i, destSlot)) {
+		int r = sr[destSlot];
+		if (sr2vr[r] != INVALID)
+			settle(r, INT_MAX);
+		if (op == loadI)
+			define(r, remat, sr[src1Slot]);
+		else
+			define(r, dirty, INVALID);
+		vr[destSlot] = sr2vr[r];
+		nu[destSlot] = FAR;
+		lastRef[r] = 3L*g + destSlot;
+	}
+}
+
+
+// helper for feedClass() and finishClass()
+// allocates the oldest instruction in the window, with c, and
+// writes it (and its spill code) to out.
+template <class P, class C>
+void AllocationContext::allocateNext(C& c) {
+	int i = done++ % intRep.size();
+	// so that chunkBase + i is its index in the block
+	chunkBase = done - 1 - i;
+	patches.reset();
+	assignRegisters<P>(c, i, i + 1);
+
+	code.clear();
+	for (int j = 0; j < patches.size(); ++j) {
+		const Patch& p = patches[j];
+		int sr[] = {p.c, INVALID, INVALID};
+		appendCode(p.op, sr, p.pr);
+		pastCycles += opInfo[p.op].latency;
+	}
+	appendCode(intRep.op[i], &intRep.sr[3*i], &intRep.pr[3*i]);
+	pastCycles += opInfo[intRep.op[i]].latency;
+	out->write(code.data(), code.size());
+	patches.reset();
 }
 
 
-// iterates through IR once and 
-// returns larget source register number + 1
-int Allocator::getNumSR() {
-	int highSR = INVALID;
-	auto it = intRep.begin();
-	while (it != intRep.end()) {
-		// in "reverse" order to reduce number of assignments
-		if (it->dest.isReg && it->dest.sr > highSR)
-			highSR = it->dest.sr;
-		if (it->src2.isReg && it->src2.sr > highSR)
-			highSR = it->src2.sr;
-		if (it->src1.isReg && it->src1.sr > highSR)
-			highSR = it->src1.sr;
-		++it;
+// helper for finish()
+// the block is over, so next uses that are not settled yet never
+// come. allocates every instruction left in the window with c.
+template <class P, class C>
+void AllocationContext::finishClass(C& c) {
+	int cap = intRep.size();
+	for (long ref : lastRef)
+		if (ref != INVALID && ref / 3 >= done)
+			intRep.nu[3*(ref / 3 % cap) + ref % 3] = INT_MAX;
+	while (done < fed)
+		allocateNext<P>(c);
+	numSlots = c.slots.size();
+	intRep.clear();
+	chunkBase = 0;
+}
+
+
+// adds constant address addr to storeAddrs
+// (doubling the table when it becomes half full)
+void AllocationContext::addStoreAddr(int addr) {
+	if (2 * (numStoreAddrs + 1) > (int)storeAddrs.size()) {
+		vector<int> old (2 * storeAddrs.size(), INVALID);
+		old.swap(storeAddrs);
+		numStoreAddrs = 0;
+		for (int a : old)
+			if (a != INVALID)
+				addStoreAddr(a);
+	}
+	size_t mask = storeAddrs.size() - 1;
+	size_t h = (addr * 2654435761u) & mask;
+	while (storeAddrs[h] != addr && storeAddrs[h] != INVALID)
+		h = (h + 1) & mask;
+	if (storeAddrs[h] == INVALID) {
+		storeAddrs[h] = addr;
+		++numStoreAddrs;
+	}
+}
+
+
+// indicates whether constant address addr is in storeAddrs
+bool AllocationContext::isStoreAddr(int addr) const {
+	size_t mask = storeAddrs.size() - 1;
+	size_t h = (addr * 2654435761u) & mask;
+	while (storeAddrs[h] != addr && storeAddrs[h] != INVALID)
+		h = (h + 1) & mask;
+	return storeAddrs[h] == addr;
+}
+
+
+
+// helper for emit()
+// appends row of legal ILOC code for Opcode op with source
+// operands sr and physical registers pr (indexed by slot) to code
+void AllocationContext::appendCode(Opcode op, const int* sr, const int* pr) {
+	// print opcode
+	code += opInfo[op].name;
+	code.append(10 - opInfo[op].len, ' ');
+	if (op == nop) {
+		code += '\n';
+		return;
+	}
+
+	// print op1 register
+	if (opInfo[op].args[src1Slot].kind == regArg && pr[src1Slot] != INVALID) {
+		code += 'r';
+		appendInt(pr[src1Slot], 9);
+	} else if (sr[src1Slot] != INVALID) {
+		appendInt(sr[src1Slot], 10);
+		if (op == output) {
+			code += '\n';
+			return;
+		}
+	}
+
+	// print op2 register
+	if (op != store && pr[src2Slot] != INVALID) {
+		code += ",  r";
+		appendInt(pr[src2Slot], 6);
+	} else
+		code.append(10, ' ');
+
+	// print arrow
+	code += "=>   ";
+
+	//print op3 register
+	if (pr[destSlot] != INVALID) {
+		code += 'r';
+		appendInt(pr[destSlot]);
+	}
+	if (op == store) {
+		code += 'r';
+		appendInt(pr[src2Slot]);
 	}
-	return highSR + 1;
+
+	// print new line
+	code += '\n';
+}
+
+
+// helper for appendCode()
+// appends v to code, padded on the right with spaces to width
+// w (what setw(w) << left << v would print). digits are written
+// by hand since to_string would build a string for each one.
+void AllocationContext::appendInt(long v, size_t w) {
+	char digits[24];
+	char* d = digits + sizeof digits;
+	unsigned long u = v < 0 ? -(unsigned long)v : v;
+	do {
+		*--d = '0' + u % 10;
+		u /= 10;
+	} while (u != 0);
+	if (v < 0)
+		*--d = '-';
+	size_t n = digits + sizeof digits - d;
+	code.append(d, n);
+	if (n < w)
+		code.append(w - n, ' ');
 }
 
 
 // pretty tabular IR printing (for debug)
-ostream& operator<<(ostream& os, const Allocator& a) {
+ostream& operator<<(ostream& os, const AllocationContext& a) {
 	// print first line of table header
 	os << "// ";
 	os << "|index| opcode ||"
@@ -421,17 +2574,30 @@ ostream& operator<<(ostream& os, const Allocator& a) {
 		"|     sr     |  vr  |  pr  |  nu  |" 
 		"|  sr  |  vr  |  pr  |  nu  |"
 		"|  sr  |  vr  |  pr  |  nu  || clean ||" << endl;
-	// print rest of IR as table
+	// print rest of IR as table, with each instruction's
+	// patches in front of it
 	int ind = 0;
-	auto it = a.intRep.begin();
-	while (it != a.intRep.end()) {
+	int j = 0;
+	int none[] = {INVALID, INVALID, INVALID};
+	for (int i = 0; i < a.intRep.size(); ++i) {
+		for (; j < a.patches.size() && a.patches[j].at == i; ++j) {
+			const Patch& p = a.patches[j];
+			int sr[] = {p.c, INVALID, INVALID};
+			// print index and rest of line
+			os << "// |" << setw(5) << left << ind++ << "|";
+			printRow(os, p.op, sr, none, p.pr, none, a.regNames);
+			os << "   -   ||" << endl;
+		}
 		// print index
-		os << "// |" << setw(5) << left << ind << "|";
+		os << "// |" << setw(5) << left << ind++ << "|";
 		// print rest of line
-		os << *it;
-// print clean
+		a.intRep.print(os, i, a.regNames);
+		// print clean (of dest, if it has a virtual register)
 		os << " ";
-		switch (a.clean[it->dest.vr]) {
+		int vr = a.intRep.vr[3*i + destSlot];
+		if (vr == INVALID)
+			os << "  -  ";
+		else switch (a.clean[vr]) {
 			case remat:
 				os << "remat";
 				break;
@@ -449,11 +2615,153 @@ ostream& operator<<(ostream& os, const Allocator& a) {
 				break;
 		}
 		os << " ||" << endl;
-
-		++it;
-		++ind;
 	}
 
 	return os;
 }
 
+
+// helper for optimize()
+// tries the script prefix followed by the best victim at every
+// point after it, and then (depth first) every script that first
+// differs from that one at one of those points, latest points
+// first, as long as allocations are left (nodesLeft). a victim
+// whose cost, on top of those before it, reaches bound is skipped.
+template <class C>
+void AllocationContext::searchFrom(C& c, const vector<int>& prefix) {
+	if (--nodesLeft < 0)
+		return;
+	script = prefix;
+	if (replay(c) && spillCycles < bound) {
+		bound = spillCycles;
+		bestScript = prefix;
+		found = true;
+	}
+	vector<SearchPoint> tried = points;
+	vector<int> costs = cost;
+	vector<int> child;
+	for (int d = tried.size() - 1; d >= (int)prefix.size(); --d) {
+		const SearchPoint& p = tried[d];
+		for (int r = 1; r < p.choices; ++r) {
+			if (p.before + costs[p.first + r] >= bound)
+				continue;
+			child = prefix;
+			child.resize(d, 0);
+			child.push_back(r);
+			searchFrom(c, child);
+			if (nodesLeft < 0)
+				return;
+		}
+	}
+}
+
+
+// helper for optimize() and searchFrom()
+// allocates intRep with c, picking victims from script, and
+// leaves what they cost in spillCycles and each point where one
+// was picked in points. stops (returning false) once they cost
+// bound cycles or more, or a store finds no register to claim.
+template <class C>
+bool AllocationContext::replay(C& c) {
+	clean = startClean;
+	vr2mem = startMem;
+	patches.reset();
+	c.reset(k, vr2mem.size());
+	c.spills = &patches;
+	c.slots.reset(SPILL);
+	spillCycles = 0;
+	points.clear();
+	cost.clear();
+	held = INVALID;
+	stuck = false;
+	for (int i = 0; i < intRep.size(); ++i) {
+		assignRegisters<SearchPolicy>(c, i, i + 1);
+		if (spillCycles >= bound || stuck)
+			return false;
+	}
+	return true;
+}
+
+
+// helper for optimize()
+// returns the cycles the allocated code takes, as the simulator
+// runs it: an operation waits for a load into a register it uses
+// or defines, and a load (or output) for a store that may write
+// the memory it reads (any store, unless both addresses are known
+// constants, as in hoistRestores, here including those computed
+// from constants). one operation starts a cycle.
+long AllocationContext::timedCycles() const {
+	vector<long> ready(numRegs, 0);		// ready[i] holds cycle ri is ready
+	vector<int> known(numRegs, INVALID);	// known[i] holds constant in ri
+	unordered_map<int, long> written;	// cycle a store to each known address is done
+	long anyStore = 0;					// cycle last store is done
+	long unknownStore = 0;				// same, for an address not known
+	long now = 0;						// cycle last operation started
+	long end = 0;						// cycle last operation is done
+	auto run = [&] (Opcode op, int cst, const int* pr) {
+		long t = now + 1;
+		for (int slot : {src1Slot, src2Slot, destSlot})
+			if (opInfo[op].args[slot].kind == regArg)
+				t = max(t, ready[pr[slot]]);
+		if (op == load || op == output) {
+			int addr = op == load ? known[pr[src1Slot]] : cst;
+			long st = anyStore;
+			if (knownAddress(addr)) {
+				auto it = written.find(addr);
+				st = max(unknownStore, it != written.end() ? it->second : 0);
+			}
+			t = max(t, st);
+		}
+		long done = t + opInfo[op].latency;
+		if (op == store) {
+			int addr = known[pr[src2Slot]];
+			anyStore = done;
+			if (knownAddress(addr))
+				written[addr] = done;
+			else
+				unknownStore = done;
+		}
+		if (isDef(op)) {
+			int v = INVALID;
+			if (op == loadI)
+				v = cst;
+			else if (op != load)
+				v = fold(op, known[pr[src1Slot]], known[pr[src2Slot]]);
+			ready[pr[destSlot]] = done;
+			known[pr[destSlot]] = v;
+		}
+		now = t;
+		end = max(end, done - 1);
+	};
+	int j = 0;
+	for (int i = 0; i < intRep.size(); ++i) {
+		for (; j < patches.size() && patches[j].at == i; ++j)
+			run(patches[j].op, patches[j].c, patches[j].pr);
+		run(intRep.op[i], intRep.sr[3*i + src1Slot], &intRep.pr[3*i]);
+	}
+	return end;
+}
+
+
+// helper for timedCycles()
+// returns what arithmetic op computes from constants x and y,
+// or INVALID if either is (32 bit, as the simulator computes)
+static int fold(Opcode op, int x, int y) {
+	if (x == INVALID || y == INVALID)
+		return INVALID;
+	uint32_t a = x, b = y;
+	switch (op) {
+		case add:
+			return a + b;
+		case sub:
+			return a - b;
+		case mult:
+			return a * b;
+		case lshift:
+			return b < 32 ? a << b : INVALID;
+		case rshift:
+			return b < 32 ? x >> b : INVALID;
+		default:
+			return INVALID;
+	}
+}
@@ -2,10 +2,11 @@
  *                                                     *
  * allocator.h                                         *
  *                                                     *
- * Contains declarations for Allocator class and its   *
- * nested Class struct, as well as  all necessary      *
- * includes and using statements not already present   *
- * in parser.h and scanner.h.                          *
+ * Contains declarations for AllocationContext class   *
+ * and its nested Class struct, the victim selection   *
+ * policies it can allocate with, as well as all       *
+ * necessary includes and using statements not already *
+ * present in parser.h, patch.h and scanner.h.         *
  *                                                     *
  * Written by: Austin James Lee                        *
  *                                                     *
@@ -14,22 +15,46 @@
 #pragma once
 
 #define SPILL 32768
+#define OUT_SIZE (1 << 16)	// bytes of code emit() buffers before writing
+#define HEAP_MIN_REGS 64	// fewer registers than this are searched linearly
+#define MASK_REGS 32		// most registers held in a MaskClass
+#define LIVE_MIN (1 << 16)	// fewest instructions computeLastUses gives a thread
+#define LANE_MIN (1 << 14)	// fewest instructions in a lane (segmented mode)
+#define STREAM_CHUNK (1 << 16)	// instructions held at once (stream mode)
+#define WINDOW 64			// instructions looked ahead (online mode)
+#define FAR (INT_MAX - 1)	// next use of a value not used in the window
+#define OPT_WORK (1 << 24)	// instructions optimize() may allocate in all
 
 #include "parser.h"
+#include "patch.h"
+#include "heap.h"
+#include "sidefile.h"
 #include <vector>
+#include <array>
 #include <stack>
-#include <algorithm>	// find, max_element, find_if
+#include <cstdint>		// uint32_t, uint64_t
+#include <cassert>		// assert
+#include <algorithm>	// max_element, lower_bound, find, sort, stable_sort, push_heap
 #include <utility>		// pair
+#include <functional>	// ref, greater
+#include <unordered_map>
 
 using std::vector;
+using std::array;
 using std::stack;
-using std::find;
 using std::max_element;
+using std::lower_bound;
+using std::find;
+using std::sort;
+using std::stable_sort;
+using std::push_heap;
+using std::pop_heap;
+using std::greater;
 using std::pair;
-using std::find_if;
+using std::ref;
+using std::unordered_map;
 
 // type aliases
-typedef list<Instruction>::iterator lit;
 typedef pair<int, int> pii;
 
 
@@ -43,43 +68,429 @@ enum Clean {
 };
 
 
-//// Allocator class ////
+//// victim selection policies ////
+
+// how allocate() picks the register to spill when none is free.
+// the allocation core takes one of the policy structs below as
+// a template parameter, so each policy gets a copy of the core
+// of its own, and choosing one costs nothing per instruction.
+// Policy names them at run time (for -a). countsUses and
+// countsCycles say what else the core keeps track of for it.
+enum Policy {
+	spillCost,		// fewest cycles of spill code for how soon needed
+	cleanFirst,		// remat, then clean, then furthest next use
+	belady,			// furthest next use
+	useCount		// as cleanFirst, by next use over uses left
+};
+
+struct CleanFirstPolicy {
+	static constexpr bool countsUses = false;
+	static constexpr bool countsCycles = false;
+};
+
+struct BeladyPolicy {
+	static constexpr bool countsUses = false;
+	static constexpr bool countsCycles = false;
+};
+
+// needs the uses left of each vr counted while allocating
+struct UseCountPolicy {
+	static constexpr bool countsUses = true;
+	static constexpr bool countsCycles = false;
+};
+
+struct SpillCostPolicy {
+	static constexpr bool countsUses = false;
+	static constexpr bool countsCycles = false;
+};
+
+// takes victims from the script optimize() is trying
+// (not one of the policies -a can choose), and needs the
+// cycles of the spill code counted (in spillCycles)
+struct SearchPolicy {
+	static constexpr bool countsUses = false;
+	static constexpr bool countsCycles = true;
+};
+
+
+//// AllocationContext class ////
 
-class Allocator {
+// scans, parses and allocates registers for blocks of ILOC code,
+// and emits the allocated code. a context owns every buffer used
+// along the way, and clears them between blocks without freeing
+// them, so once it has seen a block as large as the next one,
+// allocating that block does not touch the heap.
+class AllocationContext {
+	// struct to represent the spill addresses a Class gives out,
+	// from first up. the lowest free one goes first, so the slots
+	// of values spilled at once stay packed together, and a slot
+	// is free again once its value is done with.
+	struct SpillSlots {
+		SpillSlots();		// constructor (from SPILL)
+		void reset(int first);	// no slots in use, starting at first
+		int take(int vr);	// takes lowest free slot for vr
+		// frees addr (vr's), if it is one of these
+		void give(int addr, int vr);
+		int size() const;	// number of slots ever taken
+		int first;			// first address
+		int next;			// address of next new slot
+		vector<int> free;	// addresses free again (a min-heap)
+		// sum of mix() of each slot taken (with its vr) and each
+		// free again, so that which are in use by what can be hashed
+		uint64_t hash;
+	};
 	// struct to represent a Class of registers
 	// private because precedes public keyword
 	// 	(class members are private by default)
+	//
+	// next and cclean are only changed through setNext and
+	// setClean, which keep numRemat, numClean and (with at least
+	// HEAP_MIN_REGS registers) the heaps up to date, so that a
+	// victim can be chosen without looking at every register.
+	// vr2pr finds a resident vr without a search.
+	// known is what spill code may reuse: the constant each
+	// register (and the one kept for spilling, sz) was last given
+	// by a loadI, whether or not its value is still live.
 	struct Class {
-		Class(int numRegs);	// constructor
-		const int sz;		// k -> number of pr
+		Class();			// constructor (no registers)
+		// all numRegs registers free, for numVRs virtual registers
+		void reset(int numRegs, int numVRs);
+		void setNext(int pr, int nu);		// sets next[pr]
+		void setClean(int pr, Clean cln);	// sets cclean[pr]
+		void setKnown(int pr, int val);		// sets known[pr]
+		int holder(int val) const;			// pr known to hold val
+		RegisterHeap& typeHeap(Clean cln);	// heap of registers of type cln
+		int numSpare() const;				// free or clean registers
+		bool anyFree() const;				// indicates a pr is free
+		int popFree();						// takes pr from top of stk
+		void pushFree(int pr);				// puts pr on top of stk
+		int sz;				// k -> number of pr
 		vector<bool> free;	// free[i] indicates if ri is available
 		vector<int> name;	// name[i] holds vr assigned to ri
 		vector<int> next;	// next[i] holds nextUse of ri
 		vector<Clean> cclean;// clean[i] holds what Clean type of ri
-		stack<int> stk;		// holds i of free ri
+		stack<int, vector<int>> stk;	// holds i of free ri
+		vector<int> vr2pr;	// vr2pr[i] holds pr assigned to vri (or INVALID)
+		vector<int> known;	// known[i] holds constant in ri (or INVALID)
+		bool useHeaps;		// heaps are kept (sz >= HEAP_MIN_REGS)
+		RegisterHeap remats;	// remat registers by next (ties to highest)
+		RegisterHeap cleans;	// other clean registers by next (ties to highest)
+		RegisterHeap dirties;	// dirty registers by next (ties to highest)
+		RegisterHeap latest;	// all registers by next (ties to highest)
+		RegisterHeap latestLow;	// all registers by next (ties to lowest)
+		int numRemat;		// number of registers whose cclean is remat
+		int numClean;		// number of registers whose cclean isn't dirty
+		PatchList* spills;	// where spill code goes
+		SpillSlots slots;	// spill addresses
+	};
+	// struct to represent a Class of at most N registers
+	// (N <= MASK_REGS), which allocate() uses instead of Class
+	// for small k. everything but vr2pr (and the spill slots)
+	// lives in fixed-size arrays, and the remat and clean
+	// registers are kept as bitmasks, so optimalPR only visits
+	// the registers it must.
+	// free registers stay a stack, since its order decides which
+	// register each vr gets. a register is never pushed while it is
+	// already free (pushFree checks), so N entries is enough.
+	template <int N>
+	struct MaskClass {
+		MaskClass();		// constructor (no registers)
+		// all numRegs registers free, for numVRs virtual registers
+		void reset(int numRegs, int numVRs);
+		void setNext(int pr, int nu);		// sets next[pr]
+		void setClean(int pr, Clean cln);	// sets cclean[pr]
+		void setKnown(int pr, int val);		// sets known[pr]
+		int holder(int val) const;			// pr known to hold val
+		int numSpare() const;				// free or clean registers
+		bool anyFree() const;				// indicates a pr is free
+		int popFree();						// takes pr from top of stk
+		void pushFree(int pr);				// puts pr on top of stk
+		int sz;				// k -> number of pr
+		uint32_t remats;	// bit i set if cclean[i] is remat
+		uint32_t cleans;	// bit i set if cclean[i] isn't dirty
+		uint32_t frees;		// bit i set if ri is on stk
+		array<int, N> name;	// name[i] holds vr assigned to ri
+		array<int, N> next;	// next[i] holds nextUse of ri
+		array<Clean, N> cclean;	// clean[i] holds what Clean type of ri
+		array<int, N> stk;	// holds i of free ri (top at stk[top - 1])
+		int top;			// number of ri in stk
+		vector<int> vr2pr;	// vr2pr[i] holds pr assigned to vri (or INVALID)
+		array<int, N + 1> known;	// known[i] holds constant in ri (or INVALID)
+		PatchList* spills;	// where spill code goes
+		SpillSlots slots;	// spill addresses
+	};
+	// struct to represent a segment of the block, whose live
+	// ranges computeLastUses finds on a thread of its own
+	// before they are joined up with the rest of the block.
+	// local vrs are numbered from 0 in the order they are made.
+	struct Segment {
+		int begin;			// first instruction in segment
+		int end;			// one past last instruction in segment
+		int numVRs;			// number of local vrs
+		int base;			// global vr of first local vr not live out
+		int liveOut;		// number of sr live at end of segment
+		int maxLive;		// maximum live registers in segment
+		vector<int> sr2vr;	// sr2vr[i] holds current local vr of sri
+		vector<int> lastUse;// lastUse[i] holds last use of sri
+		vector<int> lastRef;// lastRef[i] holds last operand naming sri
+		vector<int> exposed;// first operand (from end) naming each sr
+		vector<int> upward;	// last operand (from end) naming each sr
+		vector<pii> reused;	// <local vr, global vr> of vrs live out
+		vector<int> map;	// map[i] holds global vr of local vri
+	};
+	// struct to represent a lane: a piece of the block, between
+	// two points where few values are live, that is allocated on
+	// a thread of its own in segmented mode. each value live into
+	// a lane gets a copy (a new vr) there, which starts out in
+	// memory (or rematerializable), and the lane that defines a
+	// value stores it at the end of the lane if it is still dirty.
+	struct Lane {
+		int begin;			// first instruction in lane
+		int end;			// one past last instruction in lane
+		int firstAddr;		// first spill address of lane
+		PatchList patches;	// spill code of lane
+		vector<pii> liveIn;	// <vr, copy> of values live into lane
+		vector<int> rename;	// rename[i] holds copy of vri (or INVALID)
+	};
+	// struct to represent a point where optimize() picks a victim.
+	// cost[first + r] holds what evicting the register at rank r
+	// costs (evictCost, or 0 if its value is never used again)
+	struct SearchPoint {
+		long before;		// spill cycles of victims picked before it
+		int first;			// index in cost of rank 0
+		int choices;		// ranks that may be picked
 	};
 	public:
-		// constructor. takes k and bool for print Tokens (Scanner)
-		Allocator(string infile, int = 5, bool = false);
-		list<Instruction> intRep;		// intermediate representation
+		AllocationContext();			// constructor (no block)
+		// scans and parses block from in (printing tokens if bool
+		// is set) and allocates k registers to it, using up to
+		// the given number of threads (0 for one per core), in
+		// lanes at once if the last bool is set (segmented mode)
+		void allocate(Input& in, int = 5, bool = false, int = 0, bool = false);
+		// allocates last block again, in segmented mode or not
+		void reallocate(bool seg);
+		// allocates last block again (not in segmented mode), with
+		// the victims whose spill code takes the fewest cycles, found
+		// by a search that allocates at most work instructions in
+		// all. keeps the last allocation unless that code is faster,
+		// stalls counted. returns true if the search finished
+		bool optimize(long work = OPT_WORK);
+		// scans, parses and allocates k registers to block from in
+		// (printing tokens if bool is set), and writes the allocated
+		// code to os, holding only chunk instructions at once (stream
+		// mode). the code is the same allocate() and emit() give,
+		// unless the block is longer than chunk: restores are not
+		// hoisted across chunks, and if it uses registers it never
+		// defines, one is kept for spilling (see stream()).
+		void stream(Input& in, ostream& os, int = 5, bool = false,
+										int chunk = STREAM_CHUNK);
+		// online mode: allocates k registers to a block that is fed
+		// in one instruction at a time, looking window instructions
+		// ahead, and writes each instruction to os as soon as it
+		// is allocated (when window more have been fed after it)
+		void start(ostream& os, int = 5, int window = WINDOW);
+		// feeds in next instruction, with source operands s1, s2
+		// and d (register names or constants; INVALID if absent)
+		void feed(Opcode op, int s1 = INVALID, int s2 = INVALID,
+												int d = INVALID);
+		void finish();					// allocates rest of block fed in
+		// victim selection policy for blocks allocated from now on
+		// (spillCost until set)
+		void setPolicy(Policy p);
+		long cycles() const;			// estimated cycles of allocated code
+		int lanes() const;				// number of lanes last allocation used
+		int spillSlots() const;			// spill slots last allocation used
+		// writes allocated code for last block allocated to os
+		void emit(ostream& os);
+		IR intRep;						// intermediate representation
+		RegisterNames regNames;			// source names of registers in intRep
+		PatchList patches;				// spill code to go in front of intRep
 	private:
+		AllocationContext(const AllocationContext&);			// not copyable
+		AllocationContext& operator=(const AllocationContext&);	// not assignable
+		int numRegs;					// num pr asked for
+		int threads;					// max threads to use (0 for one per core)
+		bool segmented;					// allocate lanes at once
 		int k;							// num pr available for allocation
-		int nextMemAddr;				// memory address for next spill
+		int held;						// pr kept for store addresses, or INVALID
+		bool stuck;						// a store had no pr for its address
 		int maxLive;					// maximum live registers at any point
+		Policy policy;					// victim selection policy
 		vector<int> vr2mem;				// vr2mem[i] holds spill address of vri
-//		vector<int> uses;				// uses[i] indicates num times vri is used
 		vector<Clean> clean;			// indices are vri, indicates if/how clean
-		void assignRegisters(Class c);			// map vr to k pr's
-		int ensure(lit& it, int vr, Class& c);	// ensure pr allocated to vr
-		int allocate(lit& it, int vr, Class& c);// allocates pr for vr
-		int optimalPR(Class& c);				// find optimal pr to allocate
+		vector<int> uses;				// uses[i] holds uses of vri left (useCount)
+		long pastCycles;				// cycles of code already written (stream)
+		int chunkBase;					// index in block of intRep[0] (stream, online)
+		SideFile* side;					// block on disk (stream), or nullptr
+		vector<SideRecord> records;		// chunk of side being worked on
+		vector<int> freeVRs;			// vrs whose live ranges are over (stream)
+		ostream* out;					// where code goes (online)
+		int window;						// instructions looked ahead (online)
+		int fed;						// instructions fed in (online)
+		int done;						// instructions allocated (online)
+		// lastRef[i] holds last operand (3 * index + slot) naming
+		// sri, or INVALID (online)
+		vector<long> lastRef;
+		vector<int> sr2vr;				// sr2vr[i] holds current vr of sri
+		vector<int> lastUse;			// lastUse[i] holds last use of sri
+		// clean load analysis (computeLastUses), indexed by vr:
+		// storedThrough[i] indicates a store whose address is in vri
+		// is waiting to learn that address from vri's definition;
+		// loadedThrough[i] holds index (in block) of first load seen
+		// (last in the block) whose address is in vri, or INVALID
+		vector<bool> storedThrough;
+		vector<int> loadedThrough;
+		// open addressing hash set (linear probing) of constant
+		// addresses stored to; empty slots hold INVALID
+		vector<int> storeAddrs;
+		int numStoreAddrs;				// number of addresses in storeAddrs
+		Class regs;						// state of physical registers (large k)
+		MaskClass<8> regs8;				// state of physical registers (k <= 8)
+		MaskClass<16> regs16;			// state of physical registers (k <= 16)
+		MaskClass<MASK_REGS> regs32;	// state of physical registers (k <= 32)
+		vector<unique_ptr<Lane>> laneList;	// lanes (segmented mode)
+		int numLanes;					// lanes used by last allocation
+		int numSlots;					// spill slots used by last allocation
+		vector<int> liveAt;				// liveAt[i] holds values live into i
+		vector<bool> defined;			// defined[i] indicates vri is defined
+		// optimal search (optimize): a script gives the rank (among
+		// the registers that could go, best first) of the victim to
+		// take at each point where one is picked (0 past its end)
+		vector<int> script;				// script being tried
+		vector<int> bestScript;			// cheapest script found so far
+		vector<SearchPoint> points;		// points of allocation being tried
+		vector<int> cost;				// costs of ranks at points
+		vector<int> ranked;				// registers that could go, best first
+		vector<Clean> startClean;		// clean before allocating
+		vector<int> startMem;			// vr2mem before allocating
+		long spillCycles;				// spill cycles of allocation so far
+		long bound;						// spill cycles of cheapest script so far
+		// seen[h] holds fewest spill cycles a point whose state hashes
+		// to h was reached with (see optimalPR for SearchPolicy)
+		unordered_map<uint64_t, long> seen;
+		long nodesLeft;					// scripts that may still be tried
+		bool found;						// bestScript is cheaper than last allocation
+		// restore hoisting (hoistRestores), by position in the code
+		// (patches and intRep merged)
+		vector<int> follows;			// follows[p] holds instruction after p
+		vector<int> touched;			// touched[i] holds last use of ri
+		vector<int> loaded;				// loaded[i] holds last load into ri
+		vector<int> contents;			// contents[i] holds constant in ri (or INVALID)
+		unordered_map<int, int> storedTo;	// last store to each known address
+		int lastStore;					// last store
+		int lastUnknown;				// last store to an address not known
+		vector<pii> hoisted;			// <position moved after, index> of patches
+		vector<bool> moved;				// moved[j] indicates patches[j] is hoisted
+		PatchList spare;				// patches in their new order
+		string code;					// emit's output buffer
+		void assignBlock();				// allocates intRep (after parsing)
+		void prepareBlock();			// live ranges and k for intRep
+		// moves loads in patches up (after code hoisted last, if set)
+		void hoistRestores(bool carry = false);
+		template <class P, class C>
+		void assignClass(C& c);			// allocates intRep using c
+		bool findLanes();				// splits intRep into lanes
+		// allocates lane l using c, and stores values
+		// live out of it that are only in registers
+		template <class P, class C>
+		void assignLane(Lane& l, C& c, const Lane* next);
+		// the allocation core works on either kind of class (C),
+		// and picks victims by policy P
+		template <class P, class C>
+		void assignRegisters(C& c, int begin, int end);	// map vr to k pr's
+		template <class P, class C>
+		int ensure(int at, int vr, C& c);		// ensure pr allocated to vr
+		template <class P, class C>
+		int allocate(int at, int vr, C& c);		// allocates pr for vr
+		template <class C>
+		void restoreValue(int at, int vr, int pr, C& c);	// vr back into pr
+		template <class C>
+		void storeValue(int at, int pr, int t, C& c);	// pr's value to memory
+		template <class C>
+		void dropWrites(int at, int t, C& c);	// unread restore into t
+		template <class P, class C>
+		void keepSpare(int at, int pr, C& c);	// store so a pr can be claimed
+		// find optimal pr to allocate (at instruction at), by policy
+		int optimalPR(CleanFirstPolicy, Class& c, int at);
+		template <int N>
+		int optimalPR(CleanFirstPolicy, MaskClass<N>& c, int at);
+		int optimalPR(BeladyPolicy, Class& c, int at);
+		template <int N>
+		int optimalPR(BeladyPolicy, MaskClass<N>& c, int at);
+		template <class C>
+		int optimalPR(UseCountPolicy, C& c, int at);
+		template <class C>
+		int optimalPR(SpillCostPolicy, C& c, int at);
+		int optimalPR(SpillCostPolicy, Class& c, int at);
+		template <class C>
+		int optimalPR(SearchPolicy, C& c, int at);
 		int bestOfType(Class& c, Clean ctype, bool=false);// max next for regs of ctype
-		void freeRegister(int pr, Class& c);	// frees a physical register
-		void computeLastUses();					// map sr to vr && set nu
-		void update(Register& op, int ind, int& vrName, int& numLive,
-							vector<int>& sr2vr, vector<int>& lastUse);
-		int getNumSR();		// returns number of sr
+		// find pr to hold the address of a store at instruction at
+		template <class C>
+		int scratchPR(C& c, int at);
+		int scratchPR(Class& c, int at);
+		template <class C>
+		int cleanSource(C& c, int at);			// clean source pr of at
+		template <class C>
+		int furthestDirty(C& c, int pr);		// dirty pr used furthest off
+		int furthestDirty(Class& c, int pr);
+		template <class C>
+		bool isSource(C& c, int at, int pr);	// pr holds a source of at
+		void countUses(int begin, int end);		// uses of vrs in begin to end
+		template <class C>
+		void freeRegister(int pr, C& c);		// frees a physical register
+		template <class C>
+		void freeSlot(int vr, C& c);			// frees spill slot of vr
+		template <class C>
+		void holdRegister(int pr, C& c);		// keeps pr for store addresses
+		vector<Segment> segs;			// segments for computeLastUses
+		// map sr to vr && set nu, using up to threads threads
+		void computeLastUses(int threads);
+		void update(int op, int ind, int& vrName, int& numLive);
+		void liveSegment(Segment& s);			// local live ranges of s
+		int joinSegments();						// global vrs of each segment
+		void renameSegment(Segment& s);			// global vrs and nu of s
+		void markClean(int i);					// clean analysis of instruction i
+		void markCleanLoad(int ld, int addr);	// load ld is clean, from addr
+		// next uses of a block of n instructions on side, a chunk
+		// at a time from the end, with vrs reused once they are dead.
+		// returns number of values live into the block
+		int streamLastUses(long n, int chunk);
+		// allocates block of n instructions on side using c, a
+		// chunk at a time, writing each to os once it is done
+		// (unless a store finds no register for its address in the
+		// first, when nothing is written and stuck is set)
+		template <class P, class C>
+		void streamClass(C& c, ostream& os, long n, int chunk);
+		void readChunk(long first, int n);		// side to intRep
+		void writeChunk(long first);			// intRep to side
+		template <class F>
+		void withClass(F f);					// calls f on class for k
+		template <class F>
+		void withPolicy(F f);					// calls f on policy struct
+		// adds instruction with source operands s to the window
+		// (allocating the oldest first if it is full) using c
+		template <class P, class C>
+		void feedClass(C& c, Opcode op, const int* s);
+		// allocates oldest instruction in the window and writes it out
+		template <class P, class C>
+		void allocateNext(C& c);
+		template <class P, class C>
+		void finishClass(C& c);					// allocates rest of window
+		void addStoreAddr(int addr);			// adds addr to storeAddrs
+		bool isStoreAddr(int addr) const;		// indicates addr in storeAddrs
+		// appends code for Opcode op with source operands sr
+		// and physical registers pr (indexed by slot) to code
+		void appendCode(Opcode op, const int* sr, const int* pr);
+		void appendInt(long v, size_t w = 0);	// appends v padded to w
+		// tries scripts that start with prefix (depth first) using c
+		template <class C>
+		void searchFrom(C& c, const vector<int>& prefix);
+		// allocates intRep using c with script, stopping once its
+		// victims cost bound spill cycles. returns false if it stopped
+		template <class C>
+		bool replay(C& c);
+		long timedCycles() const;	// cycles of allocated code, with stalls
 		// pretty printing of intermediate representation.
-		friend ostream& operator<<(ostream& os, const Allocator& a);
+		friend ostream& operator<<(ostream& os, const AllocationContext& a);
 };
-
@@ -0,0 +1,702 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                       *
+ * bench.cpp                                             *
+ *                                                       *
+ * Main for benchmarks of the allocator's components.    *
+ * Expects a benchmark name followed by its arguments    *
+ * (usually a list of ILOC files, e.g. blocks/timing).   *
+ * Each measurement is the best of several runs.         *
+ *                                                       *
+ * Benchmarks:                                           *
+ *   scan <files>   front end throughput in MB/s using   *
+ *                  each set of lexing kernels           *
+ *   parse <files>  front end time using 1, 2, 4, ...    *
+ *                  threads, up to one per core          *
+ *   live <files>   allocation time (front end and live  *
+ *                  ranges on threads) using 1, 2, 4,    *
+ *                  ... threads, up to one per core      *
+ *   alloc <files>  blocks per second and heap           *
+ *                  allocations per block when one       *
+ *                  AllocationContext handles every      *
+ *                  block, compared with a new context   *
+ *                  per block                            *
+ *   regs [values]  allocation time for k = 8, 16, ...,  *
+ *                  4096 on a synthetic block keeping    *
+ *                  values (default 8192) live at once   *
+ *   stores [max]   allocation time for synthetic blocks *
+ *                  of 1000, 2000, ... stores (up to max,*
+ *                  default 64000) and as many loads     *
+ *   online <files> time per instruction fed to online   *
+ *                  mode, and cycles of its code against *
+ *                  exact mode (in all, and for the      *
+ *                  block that does worst), for windows  *
+ *                  of 0, 1, 4, 16, 64 and 256           *
+ *                  instructions                         *
+ *   policies <files>                                    *
+ *                  allocation time and cycles of the    *
+ *                  code for each victim selection       *
+ *                  policy, for k = 3, 5 and 8           *
+ *   optimal <files>                                     *
+ *                  ops and cycles of the code from the  *
+ *                  default policy and from -O optimal,  *
+ *                  for each block, for k = 3, 5 and 8,  *
+ *                  and the time optimize() takes        *
+ *   slots <files>  spill slots and peak spill memory of *
+ *                  each block, for k = 3, 5 and 8, with *
+ *                  slots reused against one per value   *
+ *                                                       *
+ * Written by: Austin James Lee                          *
+ *                                                       *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#define RUNS 5
+#define ROUNDS 20	// passes over all blocks in alloc benchmark
+#define BENCH_K 5	// registers allocated in alloc benchmark
+#define REGS_VALUES 8192	// live values in regs benchmark
+#define REGS_MAX_K 4096		// largest k in regs benchmark
+#define STORES_MAX 64000	// most stores in stores benchmark
+#define WINDOW_MAX 256		// largest window in online benchmark
+
+#include "allocator.h"
+#include "kernels.h"
+#include <chrono>
+#include <functional>	// function
+#include <vector>
+#include <atomic>
+#include <cstdlib>		// malloc(), free()
+#include <new>			// bad_alloc
+#include <streambuf>
+
+using std::vector;
+using std::function;
+using std::max;
+using std::sort;
+using std::atomic;
+using std::streambuf;
+using std::streamsize;
+using namespace std::chrono;
+
+// number of calls to operator new (replaced below) so far
+static atomic<long> heapAllocs {0};
+
+// output stream buffer that discards everything written to it
+struct NullBuf : streambuf {
+	int overflow(int c) { return c; }
+	streamsize xsputn(const char*, streamsize n) { return n; }
+};
+
+// helper function prototypes
+double bestOf(function<void()> f);
+string baseName(string path);
+void benchScan(vector<string>& files);
+void benchParse(vector<string>& files);
+void benchLive(vector<string>& files);
+void benchAlloc(vector<string>& files);
+string pressureBlock(int values);
+void benchRegs(vector<string>& args);
+string storeBlock(int n);
+void benchStores(vector<string>& args);
+void benchOnline(vector<string>& files);
+void benchPolicies(vector<string>& files);
+void benchOptimal(vector<string>& files);
+void benchSlots(vector<string>& files);
+
+
+/// main ///
+int main(int argc, char* argv[]) {
+	string usage = "usage: bench <benchmark> <args...>\n"
+					"where <benchmark> is one of:\n"
+					"   scan <files>   front end throughput using each"
+					" set of lexing kernels\n"
+					"   parse <files>  front end time using 1, 2, 4, ..."
+					" threads\n"
+					"   live <files>   allocation time using 1, 2, 4, ..."
+					" threads\n"
+					"   alloc <files>  blocks per second and heap allocations"
+					" per block\n"
+					"   regs [values]  allocation time for k = 8, 16, ..., "
+					"4096\n"
+					"   stores [max]   allocation time for 1000, 2000, ..."
+					" stores\n"
+					"   online <files> time per instruction and cycles of"
+					" online mode\n"
+					"   policies <files>  allocation time and cycles for each"
+					" spill policy\n"
+					"   optimal <files>   ops and cycles of heuristic and"
+					" optimal code per block\n"
+					"   slots <files>  spill slots and memory per block";
+	if (argc < 2 || (argc < 3 && string(argv[1]) != "regs"
+							&& string(argv[1]) != "stores")) {
+		cerr << usage << endl;
+		return 1;
+	}
+
+	string which = argv[1];
+	vector<string> args (argv + 2, argv + argc);
+	if (which == "scan")
+		benchScan(args);
+	else if (which == "parse")
+		benchParse(args);
+	else if (which == "live")
+		benchLive(args);
+	else if (which == "alloc")
+		benchAlloc(args);
+	else if (which == "regs")
+		benchRegs(args);
+	else if (which == "stores")
+		benchStores(args);
+	else if (which == "online")
+		benchOnline(args);
+	else if (which == "policies")
+		benchPolicies(args);
+	else if (which == "optimal")
+		benchOptimal(args);
+	else if (which == "slots")
+		benchSlots(args);
+	else {
+		cerr << "error: unknown benchmark: " << which
+			<< endl << usage << endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+
+// replacement global allocation functions, which count allocations
+// (array and aligned forms call these)
+void* operator new(size_t n) {
+	++heapAllocs;
+	if (void* p = malloc(n ? n : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	free(p);
+}
+
+
+// runs f RUNS times and returns the
+// fastest run's time in seconds
+double bestOf(function<void()> f) {
+	double best = 0;
+	for (int i = 0; i < RUNS; ++i) {
+		auto start = steady_clock::now();
+		f();
+		double t = duration<double>(steady_clock::now() - start).count();
+		if (i == 0 || t < best)
+			best = t;
+	}
+	return best;
+}
+
+
+// returns path with any leading directories removed
+string baseName(string path) {
+	return path.substr(path.find_last_of('/') + 1);
+}
+
+
+// measures, for each file and each supported set of kernels:
+//	- "skip": throughput of the kernels alone, stripping
+//		blank lines and comments from the whole file
+//	- "parse": throughput of the whole front end (Parser)
+// in MB/s. the scalar kernels scan one byte at a time,
+// the same way the scanner did before they were added.
+void benchScan(vector<string>& files) {
+	string names[] = {"scalar", "sse2", "avx2"};
+	cout << setw(12) << left << "file" << setw(8) << "kernels"
+		<< setw(12) << "skip MB/s" << "parse MB/s" << endl;
+	for (string f : files) {
+		Input in {f};
+		double mb = in.size() / 1e6;
+		for (string k : names) {
+			if (!useKernels(k))
+				continue;
+			// strip whitespace, new lines and comments,
+			// stopping at each significant character
+			double skip = bestOf([&] {
+				const char* p = in.begin();
+				const char* end = in.end();
+				while ((p = skipSpace(p, end)) != end) {
+					if (*p == '/')
+						p = findNL(p, end);
+					else
+						p = skipBlank(findNL(p, end), end);
+				}
+			});
+			double parse = bestOf([&] {
+				Input src {f};
+				IR ir;
+				RegisterNames names;
+				Parser p {src, ir, names};
+			});
+			cout << setw(12) << left << baseName(f) << setw(8) << k
+				<< setw(12) << std::fixed << std::setprecision(1)
+				<< mb / skip << mb / parse << endl;
+		}
+	}
+	useKernels("auto");
+}
+
+
+// measures, for each file, time taken by the front end
+// (Parser) using 1, 2, 4, ... threads, up to one per core
+// (at least 4). inputs smaller than CHUNK_MIN per thread
+// use fewer threads than requested.
+void benchParse(vector<string>& files) {
+	int most = max(4u, thread::hardware_concurrency());
+	cout << setw(12) << left << "file" << setw(10) << "threads"
+		<< setw(10) << "ms" << "speedup" << endl;
+	for (string f : files) {
+		double one = 0;
+		for (int t = 1; t <= most; t *= 2) {
+			double secs = bestOf([&] {
+				Input src {f};
+				IR ir;
+				RegisterNames names;
+				Parser p {src, ir, names, false, t};
+			});
+			if (t == 1)
+				one = secs;
+			cout << setw(12) << left << baseName(f) << setw(10) << t
+				<< setw(10) << std::fixed << std::setprecision(2)
+				<< secs * 1000 << one / secs << endl;
+		}
+	}
+}
+
+
+// measures, for each file, time taken to allocate BENCH_K
+// registers (without emitting) using 1, 2, 4, ... threads, up to
+// one per core (at least 4). the front end and computeLastUses
+// both use the threads, on inputs large enough to split.
+void benchLive(vector<string>& files) {
+	int most = max(4u, thread::hardware_concurrency());
+	cout << setw(12) << left << "file" << setw(10) << "threads"
+		<< setw(10) << "ms" << "speedup" << endl;
+	for (string f : files) {
+		double one = 0;
+		AllocationContext context;
+		for (int t = 1; t <= most; t *= 2) {
+			double secs = bestOf([&] {
+				Input src {f};
+				context.allocate(src, BENCH_K, false, t);
+			});
+			if (t == 1)
+				one = secs;
+			cout << setw(12) << left << baseName(f) << setw(10) << t
+				<< setw(10) << std::fixed << std::setprecision(2)
+				<< secs * 1000 << one / secs << endl;
+		}
+	}
+}
+
+
+// allocates BENCH_K registers to each file, ROUNDS times over, and
+// reports blocks per second and heap allocations per block for:
+//	- "reused": one AllocationContext for every block, after a
+//		warm-up pass (steady state should not allocate at all)
+//	- "fresh": a new AllocationContext for every block
+// files are read into memory first, and code is emitted to a
+// stream that discards it, so neither touches files.
+void benchAlloc(vector<string>& files) {
+	vector<string> texts;
+	for (string f : files) {
+		Input src {f};
+		if (src.streaming() || !src.good()) {
+			cerr << "error: cannot read " << f << endl;
+			return;
+		}
+		texts.push_back(string(src.begin(), src.end()));
+	}
+	NullBuf nb;
+	ostream sink {&nb};
+	long blocks = ROUNDS * texts.size();
+
+	// one context for every block
+	AllocationContext context;
+	auto reuse = [&] {
+		for (string& t : texts) {
+			Input src {"block", t.data(), t.size()};
+			context.allocate(src, BENCH_K);
+			context.emit(sink);
+		}
+	};
+	reuse();	// warm up
+	long before = heapAllocs;
+	auto start = steady_clock::now();
+	for (int r = 0; r < ROUNDS; ++r)
+		reuse();
+	double reused = duration<double>(steady_clock::now() - start).count();
+	long reusedAllocs = heapAllocs - before;
+
+	// a new context for each block
+	before = heapAllocs;
+	start = steady_clock::now();
+	for (int r = 0; r < ROUNDS; ++r)
+		for (string& t : texts) {
+			Input src {"block", t.data(), t.size()};
+			AllocationContext fresh;
+			fresh.allocate(src, BENCH_K);
+			fresh.emit(sink);
+		}
+	double fresh = duration<double>(steady_clock::now() - start).count();
+	long freshAllocs = heapAllocs - before;
+
+	cout << texts.size() << " blocks, " << ROUNDS << " rounds, k = "
+		<< BENCH_K << endl;
+	cout << setw(10) << left << "context" << setw(14) << "blocks/s"
+		<< setw(14) << "allocations" << "per block" << endl;
+	cout << std::fixed << std::setprecision(1);
+	cout << setw(10) << left << "reused" << setw(14) << blocks / reused
+		<< setw(14) << reusedAllocs << (double)reusedAllocs / blocks << endl;
+	cout << setw(10) << left << "fresh" << setw(14) << blocks / fresh
+		<< setw(14) << freshAllocs << (double)freshAllocs / blocks << endl;
+}
+
+
+// returns an ILOC block which defines values registers, half of
+// them rematerializable (loadI) and half not (add), then adds
+// random pairs of them into random ones of them, 4 per value,
+// and finally adds each one into a total, so all of them stay
+// live throughout. (there are no stores, so the clean load
+// analysis in computeLastUses stays cheap and allocation is
+// what gets measured.) the block is the same every time.
+string pressureBlock(int values) {
+	unsigned seed = 12345;
+	auto rnd = [&] (int n) {
+		seed = seed * 1103515245u + 12345u;
+		return (int)((seed >> 8) % n);
+	};
+	string text;
+	auto reg = [] (int r) { return "r" + std::to_string(r); };
+	for (int i = 0; i < values; ++i) {
+		if (i < 2 || i % 2 == 0)
+			text += "loadI " + std::to_string(4 * i) + " => " + reg(i) + "\n";
+		else
+			text += "add " + reg(rnd(i)) + ", " + reg(rnd(i))
+				+ " => " + reg(i) + "\n";
+	}
+	for (int i = 0; i < 4 * values; ++i)
+		text += "add " + reg(rnd(values)) + ", " + reg(rnd(values))
+			+ " => " + reg(rnd(values)) + "\n";
+	text += "loadI 0 => " + reg(values) + "\n";
+	for (int i = 0; i < values; ++i)
+		text += "add " + reg(i) + ", " + reg(values) + " => "
+			+ reg(values) + "\n";
+	return text;
+}
+
+
+// allocates k = 8, 16, ..., REGS_MAX_K registers to a block from
+// pressureBlock (args may give its number of values), and reports
+// milliseconds per allocation (parsing and emitting included)
+// and nanoseconds per register operand.
+void benchRegs(vector<string>& args) {
+	int values = args.empty() ? REGS_VALUES : atoi(args[0].c_str());
+	if (values < 2) {
+		cerr << "error: need at least 2 values" << endl;
+		return;
+	}
+	string text = pressureBlock(values);
+	NullBuf nb;
+	ostream sink {&nb};
+	AllocationContext context;
+
+	// operands of every instruction: loadI 1, add 3
+	double operands = values / 2.0 + 3 * (values / 2.0 + 5.0 * values) + 1;
+	cout << values << " values, " << 6 * values + 1 << " operations" << endl;
+	cout << setw(8) << left << "k" << setw(12) << "ms"
+		<< "ns/operand" << endl;
+	for (int k = 8; k <= REGS_MAX_K; k *= 2) {
+		double secs = bestOf([&] {
+			Input src {"block", text.data(), text.size()};
+			context.allocate(src, k);
+			context.emit(sink);
+		});
+		cout << setw(8) << left << k << setw(12) << std::fixed
+			<< std::setprecision(2) << secs * 1000
+			<< std::setprecision(1) << secs * 1e9 / operands << endl;
+	}
+}
+
+
+// returns an ILOC block which loads from n distinct constant
+// addresses and then stores to n others, so the clean load
+// analysis in computeLastUses has n loads and n stores to track
+// (and finds every load clean).
+string storeBlock(int n) {
+	string text;
+	for (int i = 0; i < n; ++i) {
+		text += "loadI " + std::to_string(4 * i) + " => r1\n";
+		text += "load r1 => r2\n";
+		text += "add r2, r3 => r3\n";
+	}
+	for (int i = 0; i < n; ++i) {
+		text += "loadI " + std::to_string(4 * (n + i)) + " => r4\n";
+		text += "store r3 => r4\n";
+	}
+	return text;
+}
+
+
+// allocates BENCH_K registers to blocks from storeBlock with
+// 1000, 2000, 4000, ... stores, up to STORES_MAX (or args[0]),
+// and reports milliseconds per allocation (parsing and emitting
+// included) and nanoseconds per instruction, which stays flat
+// as long as the analysis is linear.
+void benchStores(vector<string>& args) {
+	int most = args.empty() ? STORES_MAX : atoi(args[0].c_str());
+	NullBuf nb;
+	ostream sink {&nb};
+	AllocationContext context;
+
+	cout << setw(10) << left << "stores" << setw(14) << "operations"
+		<< setw(12) << "ms" << "ns/operation" << endl;
+	for (int n = 1000; n <= most; n *= 2) {
+		string text = storeBlock(n);
+		double secs = bestOf([&] {
+			Input src {"block", text.data(), text.size()};
+			context.allocate(src, BENCH_K);
+			context.emit(sink);
+		});
+		cout << setw(10) << left << n << setw(14) << 5 * n << setw(12)
+			<< std::fixed << std::setprecision(2) << secs * 1000
+			<< std::setprecision(1) << secs * 1e9 / (5 * n) << endl;
+	}
+}
+
+
+// allocates BENCH_K registers to every file in online mode, with
+// windows of 0, 1, 4, 16, ..., WINDOW_MAX instructions, and reports
+// the mean, 99th percentile and worst time taken by a call to feed()
+// (each of which allocates and writes out at most one instruction;
+// the mean counts finish() too), the total cycles of the code
+// against exact mode, and the block that does worst against it
+// (a long chain of values used once, which online mode can't tell
+// are dead, is stored value by value, and hides in the total).
+// blocks are parsed first (into what feed() takes: opcode and
+// three source operands per instruction), so only feeding them in
+// is timed. an instruction comes out window instructions after it
+// goes in, however fast that is.
+void benchOnline(vector<string>& files) {
+	vector<vector<int>> blocks;
+	NullBuf nb;
+	ostream sink {&nb};
+	AllocationContext context;
+	long exact = 0;
+	vector<long> exacts;	// exact cycles of each block
+	long ops = 0;
+	for (size_t f = 0; f < files.size(); ++f) {
+		Input src {files[f]};
+		if (!src.good()) {
+			cerr << "error: cannot read " << files[f] << endl;
+			return;
+		}
+		IR ir;
+		RegisterNames names;
+		Parser {src, ir, names};
+		blocks.push_back(vector<int>());
+		for (int i = 0; i < ir.size(); ++i) {
+			blocks.back().push_back(ir.op[i]);
+			for (int slot = src1Slot; slot <= destSlot; ++slot)
+				blocks.back().push_back(ir.isReg(i, slot)
+						? names.name(ir.sr[3*i + slot]) : ir.sr[3*i + slot]);
+		}
+		ops += ir.size();
+		Input again {files[f]};
+		context.allocate(again, BENCH_K);
+		exact += context.cycles();
+		exacts.push_back(context.cycles());
+	}
+
+	cout << files.size() << " blocks, " << ops << " operations, k = "
+		<< BENCH_K << ", exact cycles " << exact << endl;
+	cout << setw(8) << left << "window" << setw(12) << "ns/feed"
+		<< setw(12) << "99% ns" << setw(12) << "worst ns" << setw(12) << "cycles"
+		<< "vs exact  worst block" << endl;
+	for (int w = 0; w <= WINDOW_MAX; w = w == 0 ? 1 : 4 * w) {
+		// mean (timing whole blocks), then worst (timing each call)
+		long cycles = 0;
+		size_t worst = 0;
+		double worstGap = 0;
+		double total = bestOf([&] {
+			cycles = 0;
+			for (size_t f = 0; f < blocks.size(); ++f) {
+				const vector<int>& b = blocks[f];
+				context.start(sink, BENCH_K, w);
+				for (size_t i = 0; i < b.size(); i += 4)
+					context.feed((Opcode)b[i], b[i+1], b[i+2], b[i+3]);
+				context.finish();
+				cycles += context.cycles();
+				double gap = (double)(context.cycles() - exacts[f])
+												/ max(1L, exacts[f]);
+				if (f == 0 || gap > worstGap) {
+					worst = f;
+					worstGap = gap;
+				}
+			}
+		});
+		vector<double> times;
+		for (const vector<int>& b : blocks) {
+			context.start(sink, BENCH_K, w);
+			for (size_t i = 0; i < b.size(); i += 4) {
+				auto start = steady_clock::now();
+				context.feed((Opcode)b[i], b[i+1], b[i+2], b[i+3]);
+				times.push_back(
+						duration<double>(steady_clock::now() - start).count());
+			}
+			context.finish();
+		}
+		sort(times.begin(), times.end());
+		cout << setw(8) << left << w << setw(12) << std::fixed
+			<< std::setprecision(1) << total * 1e9 / ops << setw(12)
+			<< times[times.size() * 99 / 100] * 1e9 << setw(12)
+			<< times.back() * 1e9 << setw(12) << cycles << std::setprecision(2)
+			<< 100.0 * (cycles - exact) / exact << "%\t  "
+			<< baseName(files[worst]) << " +" << 100.0 * worstGap << "%"
+			<< endl;
+	}
+}
+
+
+// measures, for k = 3, 5 and 8, the time each victim selection
+// policy takes to allocate every block (after it is parsed, by
+// allocating it again) and the cycles of the code it gives,
+// against the default policy (spillCost)
+void benchPolicies(vector<string>& files) {
+	const Policy policies[] = {spillCost, cleanFirst, belady, useCount};
+	const char* names[] = {"cost", "clean", "belady", "uses"};
+	AllocationContext context;
+	cout << files.size() << " blocks" << endl;
+	cout << setw(8) << left << "policy" << setw(6) << "k" << setw(12) << "ms"
+		<< setw(12) << "cycles" << "vs cost" << endl;
+	for (int k : {3, 5, 8}) {
+		double times[4] = {0, 0, 0, 0};
+		long cycles[4] = {0, 0, 0, 0};
+		for (string f : files) {
+			Input src {f};
+			if (!src.good()) {
+				cerr << "error: cannot read " << f << endl;
+				return;
+			}
+			context.allocate(src, k);
+			for (int p = 0; p < 4; ++p) {
+				context.setPolicy(policies[p]);
+				times[p] += bestOf([&] { context.reallocate(false); });
+				cycles[p] += context.cycles();
+			}
+			context.setPolicy(spillCost);
+		}
+		for (int p = 0; p < 4; ++p)
+			cout << setw(8) << left << names[p] << setw(6) << k << setw(12)
+				<< std::fixed << std::setprecision(2) << times[p] * 1e3
+				<< setw(12) << cycles[p] << 100.0 * (cycles[p] - cycles[0])
+				/ cycles[0] << "%" << endl;
+	}
+}
+
+
+// prints, for k = 3, 5 and 8 and each block, the ops and cycles
+// of the code the default policy gives, then those of the code
+// optimize() gives, whether its search covered every choice ("yes")
+// or stopped at the budget ("no"), and how long the search took
+// (once, as it starts from the block again anyway).
+// totals for each k follow.
+void benchOptimal(vector<string>& files) {
+	AllocationContext context;
+	for (int k : {3, 5, 8}) {
+		cout << "k = " << k << endl;
+		cout << setw(20) << left << "block" << setw(10) << "ops" << setw(10)
+			<< "cycles" << setw(10) << "opt ops" << setw(12) << "opt cycles"
+			<< setw(8) << "done" << "ms" << endl;
+		long ops[2] = {0, 0};
+		long cycles[2] = {0, 0};
+		int proven = 0;
+		double time = 0;
+		for (string f : files) {
+			Input src {f};
+			if (!src.good()) {
+				cerr << "error: cannot read " << f << endl;
+				return;
+			}
+			context.allocate(src, k);
+			long hOps = context.intRep.size() + context.patches.size();
+			long hCycles = context.cycles();
+			auto start = steady_clock::now();
+			bool p = context.optimize();
+			double t = duration<double>(steady_clock::now() - start).count();
+			long oOps = context.intRep.size() + context.patches.size();
+			long oCycles = context.cycles();
+			cout << setw(20) << left << baseName(f) << setw(10) << hOps
+				<< setw(10) << hCycles << setw(10) << oOps << setw(12)
+				<< oCycles << setw(8) << (p ? "yes" : "no") << std::fixed
+				<< std::setprecision(2) << t * 1e3 << endl;
+			ops[0] += hOps;
+			ops[1] += oOps;
+			cycles[0] += hCycles;
+			cycles[1] += oCycles;
+			proven += p;
+			time += t;
+		}
+		cout << setw(20) << left << "total" << setw(10) << ops[0] << setw(10)
+			<< cycles[0] << setw(10) << ops[1] << setw(12) << cycles[1]
+			<< setw(8) << proven << std::fixed << std::setprecision(2)
+			<< time * 1e3 << endl;
+		cout << "gap: " << ops[0] - ops[1] << " ops ("
+			<< std::setprecision(2) << 100.0 * (ops[0] - ops[1]) / ops[1]
+			<< "%), " << cycles[0] - cycles[1] << " cycles (" << 100.0
+			* (cycles[0] - cycles[1]) / cycles[1] << "%), " << proven << " of "
+			<< files.size() << " searched in full" << endl << endl;
+	}
+}
+
+
+// prints, for k = 3, 5 and 8 and each block, the number of values
+// spilled, which is the number of slots (and 4 bytes each, the
+// peak spill memory) it took when every value got one of its own,
+// and the number of slots and peak memory it takes now that slots
+// are reused once their values are done with. totals follow (and
+// the largest peak of any block).
+void benchSlots(vector<string>& files) {
+	AllocationContext context;
+	for (int k : {3, 5, 8}) {
+		cout << "k = " << k << endl;
+		cout << setw(20) << left << "block" << setw(10) << "spilled"
+			<< setw(12) << "bytes" << setw(10) << "slots" << "bytes" << endl;
+		long values = 0;
+		long slots = 0;
+		long peak[2] = {0, 0};
+		for (string f : files) {
+			Input src {f};
+			if (!src.good()) {
+				cerr << "error: cannot read " << f << endl;
+				return;
+			}
+			context.allocate(src, k);
+			// every value spilled is stored exactly once
+			int v = 0;
+			for (int j = 0; j < context.patches.size(); ++j)
+				v += context.patches[j].op == store;
+			int n = context.spillSlots();
+			cout << setw(20) << left << baseName(f) << setw(10) << v
+				<< setw(12) << 4 * v << setw(10) << n << 4 * n << endl;
+			values += v;
+			slots += n;
+			peak[0] = max(peak[0], 4L * v);
+			peak[1] = max(peak[1], 4L * n);
+		}
+		cout << setw(20) << left << "total" << setw(10) << values
+			<< setw(12) << 4 * values << setw(10) << slots << 4 * slots
+			<< endl;
+		cout << setw(20) << left << "largest peak" << setw(10) << ""
+			<< setw(12) << peak[0] << setw(10) << "" << peak[1] << endl
+			<< endl;
+	}
+}
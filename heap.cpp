@@ -0,0 +1,128 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                     *
+ * heap.cpp                                            *
+ *                                                     *
+ * Contains implementations for everything in heap.h.  *
+ * Methods appear in same order as they do in heap.h,  *
+ * followed by private helpers.                        *
+ *                                                     *
+ * Written by: Austin James Lee                        *
+ *                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "heap.h"
+
+
+//// RegisterHeap methods ////
+
+
+// constructor
+// takes bool indicating ties go to the lowest register
+RegisterHeap::RegisterHeap(bool l) :lowTies{l}, keys{nullptr} {}
+
+
+// empties heap and orders it by k from now on.
+// memory is kept for the next block.
+void RegisterHeap::reset(const vector<int>* k) {
+	keys = k;
+	heap.clear();
+	pos.assign(keys->size(), INVALID);
+}
+
+
+// adds register r (which must not be in heap)
+void RegisterHeap::push(int r) {
+	heap.push_back(r);
+	pos[r] = heap.size() - 1;
+	siftUp(heap.size() - 1);
+}
+
+
+// removes register r (which must be in heap)
+void RegisterHeap::remove(int r) {
+	int i = pos[r];
+	int last = heap.back();
+	heap.pop_back();
+	pos[r] = INVALID;
+	if (last == r)
+		return;
+	place(i, last);
+	siftUp(i);
+	siftDown(pos[last]);
+}
+
+
+// restores heap order after key of register r changed
+// (does nothing if r is not in heap)
+void RegisterHeap::update(int r) {
+	if (pos[r] == INVALID)
+		return;
+	siftUp(pos[r]);
+	siftDown(pos[r]);
+}
+
+
+// indicates whether register r is in heap
+bool RegisterHeap::contains(int r) const {
+	return pos[r] != INVALID;
+}
+
+
+// indicates whether heap is empty
+bool RegisterHeap::empty() const {
+	return heap.empty();
+}
+
+
+// returns register with greatest key (heap must not be empty)
+int RegisterHeap::top() const {
+	return heap[0];
+}
+
+
+// indicates register a belongs above register b:
+// a greater key, or an equal key and the preferred register
+bool RegisterHeap::above(int a, int b) const {
+	int ka = (*keys)[a];
+	int kb = (*keys)[b];
+	if (ka != kb)
+		return ka > kb;
+	return lowTies ? a < b : a > b;
+}
+
+
+// puts register r at index i of heap
+void RegisterHeap::place(int i, int r) {
+	heap[i] = r;
+	pos[r] = i;
+}
+
+
+// moves heap[i] up until its parent belongs above it
+void RegisterHeap::siftUp(int i) {
+	int r = heap[i];
+	while (i > 0 && above(r, heap[(i - 1) / 2])) {
+		place(i, heap[(i - 1) / 2]);
+		i = (i - 1) / 2;
+	}
+	place(i, r);
+}
+
+
+// moves heap[i] down until it belongs above both children
+void RegisterHeap::siftDown(int i) {
+	int r = heap[i];
+	int n = heap.size();
+	for (;;) {
+		int child = 2 * i + 1;
+		if (child >= n)
+			break;
+		if (child + 1 < n && above(heap[child + 1], heap[child]))
+			++child;
+		if (!above(heap[child], r))
+			break;
+		place(i, heap[child]);
+		i = child;
+	}
+	place(i, r);
+}
@@ -0,0 +1,51 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                     *
+ * heap.h                                              *
+ *                                                     *
+ * Contains declaration for the RegisterHeap class, an *
+ * indexed binary max-heap of physical registers       *
+ * ordered by their next use, as well as all necessary *
+ * includes and using statements not already present   *
+ * in scanner.h.                                       *
+ *                                                     *
+ * Written by: Austin James Lee                        *
+ *                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#pragma once
+
+#include "scanner.h"
+#include <vector>
+
+using std::vector;
+
+
+//// RegisterHeap class ////
+
+// a max-heap of registers (0 .. n-1) ordered by keys[r], which
+// the owner of keys changes and then reports with update(r).
+// ties go to the highest register, or to the lowest if the heap
+// is made with lowTies set. pos gives each register's place in
+// the heap, so update and remove take O(log n) and top O(1).
+class RegisterHeap {
+	public:
+		RegisterHeap(bool lowTies = false);	// constructor
+		// empties heap, which is then ordered by keys
+		// (whose size is the number of registers)
+		void reset(const vector<int>* keys);
+		void push(int r);			// adds register r
+		void remove(int r);			// removes register r
+		void update(int r);			// restores order after keys[r] changed
+		bool contains(int r) const;	// indicates r is in heap
+		bool empty() const;			// indicates heap is empty
+		int top() const;			// register with greatest key
+	private:
+		bool lowTies;				// ties go to the lowest register
+		const vector<int>* keys;	// keys[r] orders register r
+		vector<int> heap;			// registers in heap order
+		vector<int> pos;			// pos[r] is index of r in heap (or INVALID)
+		bool above(int a, int b) const;	// a belongs above b
+		void place(int i, int r);	// puts r at index i of heap
+		void siftUp(int i);			// moves heap[i] up into place
+		void siftDown(int i);		// moves heap[i] down into place
+};
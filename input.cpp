@@ -0,0 +1,236 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                     *
+ * input.cpp                                           *
+ *                                                     *
+ * Contains implementation of Input class.             *
+ *                                                     *
+ * A regular file is memory mapped when possible;      *
+ * otherwise it is read in one bulk read. Either way,  *
+ * the whole file is a single window.                  *
+ *                                                     *
+ * Anything else (stdin, pipes, devices), and a file   *
+ * opened windowed, is streamed: it is read            *
+ * incrementally, one window at a time.                *
+ * Each window ends with a new line (or at the end of  *
+ * input), so no token is ever split between windows.  *
+ *                                                     *
+ * Written by: Austin James Lee                        *
+ *                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "input.h"
+#include <fcntl.h>		// open()
+#include <unistd.h>		// read(), close(), STDIN_FILENO
+#include <sys/mman.h>	// mmap(), munmap(), madvise()
+#include <sys/stat.h>	// fstat()
+#include <cerrno>		// errno, EINTR
+#include <cstdlib>		// exit()
+#include <iostream>		// cerr
+
+using std::cerr;
+using std::endl;
+
+// helper function prototypes
+static ssize_t readSome(int fd, char* b, size_t n, const string& name);
+
+
+// default constructor
+// represents empty input.
+Input::Input()
+		:fname{""}, fd{-1}, ok{false}, data{nullptr}, len{0},
+		mapped{false}, stream{false}, avail{0} {}
+
+
+// constructor
+// opens file f, or stdin if f is "-". regular, nonempty files
+// are mapped into memory (or read into buf if mapping fails);
+// anything else is streamed, starting with its first window.
+// windowed streams regular files too, so that memory is bounded
+// by the window rather than the file (mapped pages count too).
+// the file is opened exactly once; good() reports failure.
+Input::Input(string f, bool windowed)
+		:fname{f == "-" ? "stdin" : f}, fd{-1}, ok{false}, data{nullptr},
+		len{0}, mapped{false}, stream{false}, avail{0} {
+	fd = f == "-" ? STDIN_FILENO : open(f.c_str(), O_RDONLY);
+	if (fd < 0)
+		return;
+	ok = true;
+
+	struct stat st;
+	if (!windowed && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+		if (st.st_size > 0) {
+			void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p != MAP_FAILED) {
+				// scanned front to back exactly once
+				madvise(p, st.st_size, MADV_SEQUENTIAL);
+				data = static_cast<const char*>(p);
+				len = st.st_size;
+				mapped = true;
+			} else
+				readAll();
+		}
+		closeFile();
+	} else {
+		stream = true;
+		refill();
+	}
+}
+
+
+// constructor
+// wraps n bytes already in memory at b, which must outlive the
+// Input. nothing is opened or copied, so blocks held in memory
+// can be allocated one after another without touching files.
+Input::Input(string f, const char* b, size_t n)
+		:fname{f}, fd{-1}, ok{true}, data{b}, len{n},
+		mapped{false}, stream{false}, avail{0} {}
+
+
+// destructor
+// unmaps file if it was mapped (buf frees itself otherwise),
+// and closes it if it is still open.
+Input::~Input() {
+	if (mapped)
+		munmap(const_cast<char*>(data), len);
+	closeFile();
+}
+
+
+// returns pointer to first byte of current window
+const char* Input::begin() const {
+	return data;
+}
+
+
+// returns pointer one past last byte of current window
+const char* Input::end() const {
+	return data + len;
+}
+
+
+// returns number of bytes in current window
+size_t Input::size() const {
+	return len;
+}
+
+
+// returns name of file ("stdin" for "-")
+string Input::name() const {
+	return fname;
+}
+
+
+// indicates whether file was opened successfully
+bool Input::good() const {
+	return ok;
+}
+
+
+// indicates whether input is streamed, in
+// which case size() is not the size of the file
+bool Input::streaming() const {
+	return stream;
+}
+
+
+// discards current window and reads the next one. the new window
+// ends just after its last new line, unless input ends first; the
+// partial line following it is kept for the window after.
+// returns false, with an empty window, when input is exhausted.
+// always returns false if input is not streamed.
+bool Input::refill() {
+	if (!stream)
+		return false;
+
+	// keep partial line carried over from last read
+	buf.erase(buf.begin(), buf.begin() + len);
+	avail -= len;
+	len = 0;
+	fill(1);
+	return len != 0;
+}
+
+
+// grows current window until it holds at least n bytes (still
+// ending just after a new line), or all of the remaining input.
+// pointers into the old window are invalidated, so this is only
+// for looking ahead before anything is scanned.
+// does nothing if input is not streamed.
+void Input::extend(size_t n) {
+	if (stream && len < n)
+		fill(n);
+}
+
+
+// reads until the window holds at least n bytes and ends just
+// after a new line, or until the end of input (stream only)
+void Input::fill(size_t n) {
+	len = 0;
+	size_t checked = 0;
+	while (len == 0) {
+		for (size_t i = avail; i > checked && i >= n; --i) {
+			char c = buf[i - 1];
+			if (c == '\n' || c == '\r' || c == '\f' || c == '\v') {
+				len = i;
+				break;
+			}
+		}
+		checked = avail;
+		if (len != 0)
+			break;
+		if (fd < 0) {
+			len = avail;	// end of input; last line has no new line
+			break;
+		}
+		buf.resize(avail + READ_SIZE);
+		ssize_t r = readSome(fd, &buf[avail], READ_SIZE, fname);
+		if (r > 0)
+			avail += r;
+		else
+			closeFile();
+		buf.resize(avail);
+	}
+
+	data = buf.data();
+}
+
+
+// reads entire contents of fd into buf.
+// used for regular files that cannot be mapped.
+void Input::readAll() {
+	size_t n = 0;
+	ssize_t r;
+	do {
+		buf.resize(n + READ_SIZE);
+		r = readSome(fd, &buf[n], READ_SIZE, fname);
+		if (r > 0)
+			n += r;
+	} while (r > 0);
+	buf.resize(n);
+	data = buf.data();
+	len = n;
+}
+
+
+// closes fd (leaving stdin open for the caller)
+void Input::closeFile() {
+	if (fd > STDIN_FILENO)
+		close(fd);
+	fd = -1;
+}
+
+
+// reads up to n bytes of fd into b, as read() does, trying again
+// if it is interrupted. returns 0 at the end of input. if the read
+// fails, prints an error naming the input and terminates, rather
+// than allocating whatever had been read as the whole block.
+static ssize_t readSome(int fd, char* b, size_t n, const string& name) {
+	ssize_t r;
+	while ((r = read(fd, b, n)) < 0 && errno == EINTR)
+		;
+	if (r < 0) {
+		cerr << "error: could not read: " << name << endl;
+		exit(EXIT_FAILURE);
+	}
+	return r;
+}
@@ -0,0 +1,63 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                     *
+ * input.h                                             *
+ *                                                     *
+ * Contains declaration for Input class, which holds   *
+ * the contents of a source file in memory so that it  *
+ * can be scanned directly out of a byte buffer, as    *
+ * well as all necessary includes and using            *
+ * statements.                                         *
+ *                                                     *
+ * Written by: Austin James Lee                        *
+ *                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#pragma once
+
+// bytes requested per read() when streaming
+#define READ_SIZE (1 << 16)
+
+#include <string>
+#include <vector>
+#include <cstddef>	// size_t
+
+using std::string;
+using std::vector;
+using std::size_t;
+
+
+//// Input class ////
+
+class Input {
+	public:
+		Input();						// default constructor (empty input)
+		// opens file f ("-" for stdin), streaming it even if it
+		// is a regular file if bool is set
+		Input(string f, bool = false);
+		// wraps n bytes at b (not copied), named f in diagnostics
+		Input(string f, const char* b, size_t n);
+		~Input();						// unmaps or closes file
+		const char* begin() const;		// first byte of current window
+		const char* end() const;		// one past last byte of current window
+		size_t size() const;			// number of bytes in current window
+		string name() const;			// name to use in diagnostics
+		bool good() const;				// indicates file was opened
+		bool streaming() const;			// indicates input arrives in windows
+		bool refill();					// replaces window with the next one
+		void extend(size_t n);			// grows window to at least n bytes
+	private:
+		Input(const Input&);			// not copyable
+		Input& operator=(const Input&);	// not assignable
+		string fname;			// name of file
+		int fd;					// file descriptor (-1 when done with it)
+		bool ok;				// indicates file was opened
+		const char* data;		// start of current window
+		size_t len;				// number of bytes in current window
+		bool mapped;			// indicates data must be unmapped
+		bool stream;			// indicates input is read incrementally
+		size_t avail;			// bytes read into buf (stream only)
+		vector<char> buf;		// holds file contents if not mapped
+		void readAll();			// fallback when mmap isn't possible
+		void fill(size_t n);	// reads window of at least n bytes
+		void closeFile();		// closes fd unless it is stdin
+};
@@ -0,0 +1,214 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                       *
+ * ir.cpp                                                *
+ *                                                       *
+ * Contains implementations for everything in ir.h that *
+ * is not defined there. Methods appear in same order as *
+ * they do in ir.h.                                      *
+ *                                                       *
+ * Written by: Austin James Lee                          *
+ *                                                       *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "ir.h"
+
+
+//// RegisterNames methods ////
+
+
+// constructor
+RegisterNames::RegisterNames() :numLarge{0} {}
+
+
+// returns dense number for source register sr, giving it
+// the next number if this is the first time it is seen.
+// small names are looked up in a vector; the rest, which
+// are rare, in a hash table, so memory is proportional
+// to the number of distinct registers.
+int RegisterNames::rename(int sr) {
+	if (sr < SMALL_SR) {
+		if (sr >= (int)small.size())
+			small.resize(min(SMALL_SR, 2 * sr + 16), INVALID);
+		if (small[sr] == INVALID) {
+			small[sr] = names.size();
+			names.push_back(sr);
+		}
+		return small[sr];
+	}
+	if (2 * (numLarge + 1) > (int)large.size())
+		growLarge();
+	size_t mask = large.size() - 1;
+	size_t h = (sr * 2654435761u) & mask;
+	while (large[h].first != sr && large[h].first != INVALID)
+		h = (h + 1) & mask;
+	if (large[h].first == INVALID) {
+		large[h] = {sr, (int)names.size()};
+		names.push_back(sr);
+		++numLarge;
+	}
+	return large[h].second;
+}
+
+
+// returns number of distinct source registers renamed
+int RegisterNames::size() const {
+	return names.size();
+}
+
+
+// returns source register that was renamed to r
+int RegisterNames::name(int r) const {
+	return names[r];
+}
+
+
+// forgets all names, so the next sr renamed is numbered 0.
+// only entries that were used are cleared, and no memory is
+// freed, so renaming the next block's registers costs the same
+// as if it were the first.
+void RegisterNames::reset() {
+	for (int sr : names)
+		if (sr < SMALL_SR)
+			small[sr] = INVALID;
+	if (numLarge > 0)
+		fill(large.begin(), large.end(), pair<int, int> {INVALID, INVALID});
+	numLarge = 0;
+	names.clear();
+}
+
+
+// doubles size of large (to at least 16 slots), reinserting its names
+void RegisterNames::growLarge() {
+	vector<pair<int, int>> old (max<size_t>(16, 2 * large.size()),
+										pair<int, int> {INVALID, INVALID});
+	old.swap(large);
+	size_t mask = large.size() - 1;
+	for (const pair<int, int>& e : old) {
+		if (e.first == INVALID)
+			continue;
+		size_t h = (e.first * 2654435761u) & mask;
+		while (large[h].first != INVALID)
+			h = (h + 1) & mask;
+		large[h] = e;
+	}
+}
+
+
+
+//// IR methods ////
+
+
+// appends instruction o with source operands s1, s2 and d.
+// its virtual and physical registers and next uses are INVALID.
+// returns index of new instruction.
+int IR::add(Opcode o, int s1, int s2, int d) {
+	op.push_back(o);
+	sr.push_back(s1);
+	sr.push_back(s2);
+	sr.push_back(d);
+	for (int slot = src1Slot; slot <= destSlot; ++slot) {
+		vr.push_back(INVALID);
+		pr.push_back(INVALID);
+		nu.push_back(INVALID);
+	}
+	return op.size() - 1;
+}
+
+
+// resizes to n instructions. new instructions
+// are nops with all fields INVALID.
+void IR::resize(int n) {
+	op.resize(n, nop);
+	sr.resize(3 * n, INVALID);
+	vr.resize(3 * n, INVALID);
+	pr.resize(3 * n, INVALID);
+	nu.resize(3 * n, INVALID);
+}
+
+
+// removes all instructions. memory is kept for the next block.
+void IR::clear() {
+	op.clear();
+	sr.clear();
+	vr.clear();
+	pr.clear();
+	nu.clear();
+}
+
+
+// exchanges contents with other
+void IR::swap(IR& other) {
+	op.swap(other.op);
+	sr.swap(other.sr);
+	vr.swap(other.vr);
+	pr.swap(other.pr);
+	nu.swap(other.nu);
+}
+
+
+// pretty prints instruction i as a table row (for -p)
+void IR::print(ostream& os, int i, const RegisterNames& names) const {
+	printRow(os, op[i], &sr[3*i], &vr[3*i], &pr[3*i], &nu[3*i], names);
+}
+
+
+
+//// IR functions ////
+
+
+// pretty prints a table row (for -p)
+// opcode field: 8
+//	- max opcode is 6 chars + 1 space of padding
+// first sr field for an instruction: 12 spaces
+//	- up to INT_MAX with 1 space padding
+// all other register fields: 6 spaces
+//	- register value up to 1000 with 1 space padding
+void printRow(ostream& os, Opcode op, const int* sr, const int* vr,
+				const int* pr, const int* nu, const RegisterNames& names) {
+	string noReg = "  -   ";
+	// print Opcode
+	os << " " << setw(7) << left << opInfo[op].name << "|||";
+
+	// print registers!
+	for (int slot = src1Slot; slot <= destSlot; ++slot) {
+		// print source register
+		if (sr[slot] == INVALID) {
+			os << noReg;
+			if (slot == src1Slot)
+				os << "      ";
+		} else if (opInfo[op].args[slot].kind == regArg) {
+			os << " r";
+			// set field width
+			if (slot == src1Slot)
+				os << setw(10);
+			else
+				os << setw(4);
+			os << left << names.name(sr[slot]);
+		} else
+			os << " " << setw(11) << left << sr[slot];
+		os << "|";
+
+		// print virtual register
+		if (vr[slot] == INVALID)
+			os << noReg;
+		else
+			os << " v" << setw(4) << left << vr[slot];
+		os << "|";
+
+		// print physical register
+		if (pr[slot] == INVALID)
+			os << noReg;
+		else
+			os << " r" << setw(4) << left << pr[slot];
+		os << "|";
+
+		// print next use
+		if (nu[slot] == INVALID)
+			os << noReg;
+		else if (nu[slot] == INT_MAX)
+			os << " INF  ";
+		else
+			os << " " << setw(5) << left << nu[slot];
+		os << "||";
+	}
+}
@@ -0,0 +1,97 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                       *
+ * ir.h                                                  *
+ *                                                       *
+ * Contains declarations for the IR structure, which     *
+ * holds a block of instructions as a struct of arrays,  *
+ * and the RegisterNames class, which renumbers its      *
+ * source registers, as well as all necessary includes   *
+ * and using statements not already present in          *
+ * scanner.h.                                            *
+ *                                                       *
+ * Instruction i is op[i], and its operands are at index *
+ * 3*i + slot of sr, vr, pr and nu, where slot is one of *
+ * src1Slot, src2Slot and destSlot (see opcodes.h).      *
+ * Whether an operand is a register or a constant (or    *
+ * absent) is given by opInfo, so it is not stored.      *
+ *                                                       *
+ * Written by: Austin James Lee                          *
+ *                                                       *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#pragma once
+
+// source registers below this are renumbered through a vector
+#define SMALL_SR (1 << 16)
+
+#include "scanner.h"
+#include <vector>
+#include <iomanip>
+#include <algorithm>	// min, max, fill
+#include <utility>		// pair
+
+using std::vector;
+using std::setw;
+using std::left;
+using std::min;
+using std::max;
+using std::fill;
+using std::pair;
+
+
+//// RegisterNames class ////
+
+// renumbers source registers densely (0, 1, 2, ...) in the order
+// they first appear, so that later passes can index arrays by
+// register no matter how large the names in the source are.
+class RegisterNames {
+	public:
+		RegisterNames();		// constructor (no names)
+		int rename(int sr);		// returns number for source register sr
+		int size() const;		// number of distinct source registers
+		int name(int r) const;	// source register that was renamed to r
+		void reset();			// forgets all names (keeps memory)
+	private:
+		vector<int> names;	// names[r] is source register renamed to r
+		vector<int> small;	// small[sr] is number for sr < SMALL_SR
+		// open addressing hash table (linear probing) holding
+		// <sr, number> for all other sr; empty slots have sr INVALID
+		vector<pair<int, int>> large;
+		int numLarge;		// number of sr in large
+		void growLarge();	// doubles size of large
+};
+
+
+//// IR structure ////
+
+struct IR {
+	vector<Opcode> op;	// op[i] is Opcode of instruction i
+	vector<int> sr;		// source register (renamed) or constant
+	vector<int> vr;		// virtual register
+	vector<int> pr;		// physical register
+	vector<int> nu;		// index of next use of the register
+	// number of instructions
+	// (this and isReg are defined here so that passes can inline them)
+	int size() const { return op.size(); }
+	// indicates whether operand slot of instruction i is a register
+	bool isReg(int i, int slot) const {
+		return opInfo[op[i]].args[slot].kind == regArg;
+	}
+	// appends instruction with source operands s1, s2 and d
+	// (INVALID if absent) and returns its index
+	int add(Opcode o, int s1 = INVALID, int s2 = INVALID, int d = INVALID);
+	void resize(int n);				// resizes to n instructions
+	void clear();					// removes all instructions (keeps memory)
+	void swap(IR& other);			// exchanges contents with other
+	// pretty prints instruction i as a table row for -p, with
+	// registers under their source names
+	void print(ostream& os, int i, const RegisterNames& names) const;
+};
+
+
+//// IR functions ////
+
+// pretty prints a table row for -p: Opcode op, and the sr, vr, pr
+// and nu of each of its operands (indexed by slot)
+void printRow(ostream& os, Opcode op, const int* sr, const int* vr,
+				const int* pr, const int* nu, const RegisterNames& names);
@@ -0,0 +1,123 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                     *
+ * irfile.cpp                                          *
+ *                                                     *
+ * Contains implementations of the functions declared  *
+ * in irfile.h, which read and write the binary IR     *
+ * file format described there.                        *
+ *                                                     *
+ * Written by: Austin James Lee                        *
+ *                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "irfile.h"
+#include <cstring>	// memcmp(), memcpy()
+
+using std::memcmp;
+using std::memcpy;
+
+// helper function prototypes
+static uint32_t fnv1a(const char* b, const char* e);
+static size_t padded(size_t n);
+static void corrupt(string name, string msg);
+
+
+// indicates whether [b, e) begins with an IR file header
+bool isIRFile(const char* b, const char* e) {
+	return e - b >= (long)sizeof(IRHeader) && memcmp(b, IR_MAGIC, 4) == 0;
+}
+
+
+// writes ir to file f in the IR file format, with
+// registers under their source names (given by names).
+// terminates if f cannot be written.
+void writeIRFile(string f, const IR& ir, const RegisterNames& names) {
+	size_t n = ir.size();
+	vector<char> body (padded(n) + 3 * n * sizeof(int32_t), 0);
+
+	// fill in sections (opcodes are already one byte each)
+	copy(ir.op.begin(), ir.op.end(), (Opcode*)body.data());
+	int32_t* srcs = (int32_t*)(body.data() + padded(n));
+	for (size_t i = 0; i < n; ++i)
+		for (int slot = src1Slot; slot <= destSlot; ++slot) {
+			int sr = ir.sr[3*i + slot];
+			srcs[slot * n + i] = ir.isReg(i, slot) ? names.name(sr) : sr;
+		}
+
+	IRHeader h;
+	memcpy(h.magic, IR_MAGIC, 4);
+	h.version = IR_VERSION;
+	h.reserved = 0;
+	h.count = n;
+	h.checksum = fnv1a(body.data(), body.data() + body.size());
+
+	ofstream out {f, ofstream::binary};
+	out.write((const char*)&h, sizeof h);
+	out.write(body.data(), body.size());
+	if (!out) {
+		cerr << "error: could not write IR file: " << f << endl;
+		exit(EXIT_FAILURE);
+	}
+}
+
+
+// appends the instructions in IR file [b, e) to ir, copying the
+// file's arrays into its own (renaming registers with names).
+// terminates if the file is corrupt (named name in the message).
+void readIRFile(string name, const char* b, const char* e,
+										IR& ir, RegisterNames& names) {
+	IRHeader h;
+	memcpy(&h, b, sizeof h);
+	if (h.version != IR_VERSION)
+		corrupt(name, "unsupported IR file version " + to_string(h.version));
+	size_t n = h.count;
+	const char* body = b + sizeof h;
+	if ((size_t)(e - body) != padded(n) + 3 * n * sizeof(int32_t))
+		corrupt(name, "IR file has wrong size");
+	if (fnv1a(body, e) != h.checksum)
+		corrupt(name, "IR file checksum mismatch");
+
+	// sections may not be aligned, so copy values out
+	const char* ops = body;
+	const char* srcs = body + padded(n);
+	size_t first = ir.size();
+	ir.resize(first + n);
+	for (size_t i = 0; i < n; ++i) {
+		if ((uint8_t)ops[i] >= NUM_OPCODES)
+			corrupt(name, "invalid opcode in IR file");
+		ir.op[first + i] = (Opcode)ops[i];
+		for (int slot = src1Slot; slot <= destSlot; ++slot) {
+			int32_t v;
+			memcpy(&v, srcs + 4 * (slot * n + i), 4);
+			Kind kind = opInfo[(uint8_t)ops[i]].args[slot].kind;
+			if ((kind == noArg) != (v == INVALID) || v < INVALID)
+				corrupt(name, "invalid operand in IR file");
+			ir.sr[3*(first + i) + slot] = kind == regArg ? names.rename(v) : v;
+		}
+	}
+}
+
+
+// 32 bit FNV-1a hash of [b, e)
+static uint32_t fnv1a(const char* b, const char* e) {
+	uint32_t h = 2166136261u;
+	for (; b != e; ++b) {
+		h ^= (uint8_t)*b;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+
+// n rounded up to a multiple of 4
+static size_t padded(size_t n) {
+	return (n + 3) & ~(size_t)3;
+}
+
+
+// prints error message about corrupt IR file and terminates
+static void corrupt(string name, string msg) {
+	cerr << name << ": ERROR: " << msg << endl
+		<< "Terminating program." << endl;
+	exit(EXIT_FAILURE);
+}
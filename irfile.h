@@ -0,0 +1,66 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                     *
+ * irfile.h                                            *
+ *                                                     *
+ * Contains declarations for reading and writing the   *
+ * binary IR file format, as well as all necessary     *
+ * includes and using statements not already present   *
+ * in parser.h and scanner.h.                          *
+ *                                                     *
+ * An IR file holds a parsed block so it can be        *
+ * allocated again without scanning and parsing its    *
+ * text. All values are in host byte order:            *
+ *                                                     *
+ *   header   magic "ILIR", version, count, checksum   *
+ *   ops      count Opcodes, one byte each, padded     *
+ *            with zeros to a multiple of 4 bytes      *
+ *   src1     count int32 source values (register      *
+ *            name or constant; -1 if absent)          *
+ *   src2     count int32 source values                *
+ *   dest     count int32 source values                *
+ *                                                     *
+ * The checksum is FNV-1a over everything after the    *
+ * header.                                             *
+ *                                                     *
+ * Written by: Austin James Lee                        *
+ *                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#pragma once
+
+#define IR_MAGIC "ILIR"
+#define IR_VERSION 1
+
+#include "parser.h"
+#include <cstdint>	// uint8_t, uint16_t, uint32_t, int32_t
+
+using std::uint8_t;
+using std::uint16_t;
+using std::uint32_t;
+using std::int32_t;
+using std::ofstream;
+using std::to_string;
+
+
+//// IRHeader structure ////
+
+struct IRHeader {
+	char magic[4];		// IR_MAGIC
+	uint16_t version;	// IR_VERSION
+	uint16_t reserved;	// zero
+	uint32_t count;		// number of Instructions
+	uint32_t checksum;	// FNV-1a of everything after the header
+};
+
+
+//// IR file functions ////
+
+// indicates whether [b, e) begins with an IR file header
+bool isIRFile(const char* b, const char* e);
+// writes ir (whose registers were renamed by names) to
+// file f, terminating on failure
+void writeIRFile(string f, const IR& ir, const RegisterNames& names);
+// appends IR file [b, e) (named name) to ir, renaming its registers
+// with names, and terminating if it is corrupt
+void readIRFile(string name, const char* b, const char* e,
+										IR& ir, RegisterNames& names);
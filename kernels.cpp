@@ -0,0 +1,322 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                     *
+ * kernels.cpp                                         *
+ *                                                     *
+ * Contains implementations of the lexing kernels and  *
+ * runtime kernel selection declared in kernels.h.     *
+ *                                                     *
+ * Whitespace is ' ' and '\t'. New lines are '\n',     *
+ * '\v', '\f' and '\r' (10 through 13), matching       *
+ * Scanner::ensureNL(). Since 9 through 13 are also    *
+ * contiguous, both classes are tested with a single   *
+ * unsigned range compare.                             *
+ *                                                     *
+ * Written by: Austin James Lee                        *
+ *                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "kernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define X86_KERNELS
+#include <immintrin.h>
+#endif
+
+
+//// character classes ////
+
+
+// ' ' or '\t'
+static inline bool isBlank(unsigned char c) {
+	return c == ' ' || c == '\t';
+}
+
+
+// '\t' through '\r', or ' '
+static inline bool isSpace(unsigned char c) {
+	return (unsigned char)(c - '\t') <= '\r' - '\t' || c == ' ';
+}
+
+
+// '\n' through '\r'
+static inline bool isNL(unsigned char c) {
+	return (unsigned char)(c - '\n') <= '\r' - '\n';
+}
+
+
+
+//// scalar kernels ////
+
+
+static const char* skipBlankScalar(const char* p, const char* end) {
+	while (p != end && isBlank(*p))
+		++p;
+	return p;
+}
+
+
+static const char* skipSpaceScalar(const char* p, const char* end) {
+	while (p != end && isSpace(*p))
+		++p;
+	return p;
+}
+
+
+static const char* findNLScalar(const char* p, const char* end) {
+	while (p != end && !isNL(*p))
+		++p;
+	return p;
+}
+
+
+static int countNLScalar(const char* p, const char* end) {
+	int n = 0;
+	for (; p != end; ++p)
+		n += isNL(*p);
+	return n;
+}
+
+
+
+#ifdef X86_KERNELS
+
+//// SSE2 kernels ////
+// each builds a 16 bit mask with bit i set if byte i
+// is in the class being searched for, then scans it with ctz.
+
+
+// mask of bytes in [lo, lo + span]
+static inline int rangeMask16(__m128i v, char lo, char span) {
+	__m128i t = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+	return _mm_movemask_epi8(
+		_mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(span)), t));
+}
+
+
+static const char* skipBlankSSE2(const char* p, const char* end) {
+	const __m128i sp = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	for (; end - p >= 16; p += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)p);
+		int m = _mm_movemask_epi8(_mm_or_si128(
+			_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, tab))) ^ 0xFFFF;
+		if (m)
+			return p + __builtin_ctz(m);
+	}
+	return skipBlankScalar(p, end);
+}
+
+
+static const char* skipSpaceSSE2(const char* p, const char* end) {
+	const __m128i sp = _mm_set1_epi8(' ');
+	for (; end - p >= 16; p += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)p);
+		int m = (rangeMask16(v, '\t', '\r' - '\t') |
+				_mm_movemask_epi8(_mm_cmpeq_epi8(v, sp))) ^ 0xFFFF;
+		if (m)
+			return p + __builtin_ctz(m);
+	}
+	return skipSpaceScalar(p, end);
+}
+
+
+static const char* findNLSSE2(const char* p, const char* end) {
+	for (; end - p >= 16; p += 16) {
+		int m = rangeMask16(_mm_loadu_si128((const __m128i*)p),
+											'\n', '\r' - '\n');
+		if (m)
+			return p + __builtin_ctz(m);
+	}
+	return findNLScalar(p, end);
+}
+
+
+static int countNLSSE2(const char* p, const char* end) {
+	int n = 0;
+	for (; end - p >= 16; p += 16)
+		n += __builtin_popcount(rangeMask16(
+			_mm_loadu_si128((const __m128i*)p), '\n', '\r' - '\n'));
+	return n + countNLScalar(p, end);
+}
+
+
+
+//// AVX2 kernels ////
+// same as SSE2 kernels, 32 bytes at a time.
+// compiled for AVX2 regardless of -march; only
+// called if the CPU reports AVX2 support.
+// most runs in ILOC source are shorter than 16 bytes,
+// so each first probes 16 bytes with SSE2 and only
+// switches to 32 byte steps for longer runs.
+
+
+__attribute__((target("avx2")))
+static inline unsigned rangeMask32(__m256i v, char lo, char span) {
+	__m256i t = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+	return _mm256_movemask_epi8(
+		_mm256_cmpeq_epi8(_mm256_min_epu8(t, _mm256_set1_epi8(span)), t));
+}
+
+
+__attribute__((target("avx2")))
+static const char* skipBlankAVX2(const char* p, const char* end) {
+	if (end - p >= 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)p);
+		int m = _mm_movemask_epi8(_mm_or_si128(
+			_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+			_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')))) ^ 0xFFFF;
+		if (m)
+			return p + __builtin_ctz(m);
+		p += 16;
+	}
+	const __m256i sp = _mm256_set1_epi8(' ');
+	const __m256i tab = _mm256_set1_epi8('\t');
+	for (; end - p >= 32; p += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)p);
+		unsigned m = ~(unsigned)_mm256_movemask_epi8(_mm256_or_si256(
+			_mm256_cmpeq_epi8(v, sp), _mm256_cmpeq_epi8(v, tab)));
+		if (m)
+			return p + __builtin_ctz(m);
+	}
+	return skipBlankSSE2(p, end);
+}
+
+
+__attribute__((target("avx2")))
+static const char* skipSpaceAVX2(const char* p, const char* end) {
+	if (end - p >= 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)p);
+		int m = (rangeMask16(v, '\t', '\r' - '\t') | _mm_movemask_epi8(
+				_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')))) ^ 0xFFFF;
+		if (m)
+			return p + __builtin_ctz(m);
+		p += 16;
+	}
+	const __m256i sp = _mm256_set1_epi8(' ');
+	for (; end - p >= 32; p += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)p);
+		unsigned m = ~(rangeMask32(v, '\t', '\r' - '\t') |
+				(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, sp)));
+		if (m)
+			return p + __builtin_ctz(m);
+	}
+	return skipSpaceSSE2(p, end);
+}
+
+
+__attribute__((target("avx2")))
+static const char* findNLAVX2(const char* p, const char* end) {
+	if (end - p >= 16) {
+		int m = rangeMask16(_mm_loadu_si128((const __m128i*)p),
+											'\n', '\r' - '\n');
+		if (m)
+			return p + __builtin_ctz(m);
+		p += 16;
+	}
+	for (; end - p >= 32; p += 32) {
+		unsigned m = rangeMask32(_mm256_loadu_si256((const __m256i*)p),
+												'\n', '\r' - '\n');
+		if (m)
+			return p + __builtin_ctz(m);
+	}
+	return findNLSSE2(p, end);
+}
+
+
+__attribute__((target("avx2")))
+static int countNLAVX2(const char* p, const char* end) {
+	int n = 0;
+	for (; end - p >= 32; p += 32)
+		n += __builtin_popcount(rangeMask32(
+			_mm256_loadu_si256((const __m256i*)p), '\n', '\r' - '\n'));
+	return n + countNLSSE2(p, end);
+}
+
+#endif	// X86_KERNELS
+
+
+
+//// kernel selection ////
+
+
+// one set of kernels
+struct Kernels {
+	const char* name;
+	const char* (*skipBlank)(const char*, const char*);
+	const char* (*skipSpace)(const char*, const char*);
+	const char* (*findNL)(const char*, const char*);
+	int (*countNL)(const char*, const char*);
+};
+
+static const Kernels scalarKernels = {"scalar",
+	skipBlankScalar, skipSpaceScalar, findNLScalar, countNLScalar};
+#ifdef X86_KERNELS
+static const Kernels sse2Kernels = {"sse2",
+	skipBlankSSE2, skipSpaceSSE2, findNLSSE2, countNLSSE2};
+static const Kernels avx2Kernels = {"avx2",
+	skipBlankAVX2, skipSpaceAVX2, findNLAVX2, countNLAVX2};
+#endif
+
+
+// returns widest kernels supported by the CPU
+static const Kernels* bestKernels() {
+#ifdef X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return &avx2Kernels;
+	if (__builtin_cpu_supports("sse2"))
+		return &sse2Kernels;
+#endif
+	return &scalarKernels;
+}
+
+
+// selected kernels, chosen before main() runs
+static const Kernels* kernels = bestKernels();
+
+
+bool useKernels(string name) {
+	const Kernels* k = nullptr;
+	if (name == "auto")
+		k = bestKernels();
+	else if (name == "scalar")
+		k = &scalarKernels;
+#ifdef X86_KERNELS
+	else if (name == "sse2" && __builtin_cpu_supports("sse2"))
+		k = &sse2Kernels;
+	else if (name == "avx2" && __builtin_cpu_supports("avx2"))
+		k = &avx2Kernels;
+#endif
+	if (k)
+		kernels = k;
+	return k != nullptr;
+}
+
+
+string kernelName() {
+	return kernels->name;
+}
+
+
+
+//// dispatching kernels ////
+
+
+const char* skipBlank(const char* p, const char* end) {
+	return kernels->skipBlank(p, end);
+}
+
+
+const char* skipSpace(const char* p, const char* end) {
+	return kernels->skipSpace(p, end);
+}
+
+
+const char* findNL(const char* p, const char* end) {
+	return kernels->findNL(p, end);
+}
+
+
+int countNL(const char* p, const char* end) {
+	return kernels->countNL(p, end);
+}
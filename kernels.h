@@ -0,0 +1,44 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                     *
+ * kernels.h                                           *
+ *                                                     *
+ * Contains declarations for the lexing kernels used   *
+ * by Scanner to skip whitespace, comments, and blank  *
+ * lines, as well as all necessary includes and using  *
+ * statements.                                         *
+ *                                                     *
+ * Each kernel has a scalar implementation and, on x86 *
+ * targets, SSE2 (16 byte) and AVX2 (32 byte) vector   *
+ * implementations. The widest one supported by the    *
+ * CPU is selected at runtime.                         *
+ *                                                     *
+ * Written by: Austin James Lee                        *
+ *                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#pragma once
+
+#include <string>
+
+using std::string;
+
+
+//// lexing kernels ////
+
+// returns first character in [p, end) that is not a space or tab
+const char* skipBlank(const char* p, const char* end);
+// returns first character in [p, end) that is not whitespace or a new line
+const char* skipSpace(const char* p, const char* end);
+// returns first new line character in [p, end), or end
+const char* findNL(const char* p, const char* end);
+// returns number of new line characters in [p, end)
+int countNL(const char* p, const char* end);
+
+
+//// kernel selection ////
+
+// selects kernels by name ("scalar", "sse2", "avx2" or "auto").
+// returns false, leaving selection unchanged, if not supported.
+bool useKernels(string name);
+// returns name of selected kernels
+string kernelName();
@@ -2,13 +2,15 @@
  *                                                       *
  * main.cpp                                              *
  *                                                       *
- * Main for Allocator implementation.                    *
- * Expects file as command line argument.                *
- * Uses file to construct Allocator, which constructs    *
+ * Main for register allocator implementation.           *
+ * Expects file as command line argument, or reads stdin *
+ * if there is none. Code is written to stdout, so alloc *
+ * can run in the middle of a pipeline.                  *
+ * Hands file to an AllocationContext, which constructs  *
  * a Parser (that constructs a Scanner) to parse and     *
  * scan file and build its intermediate representation,  *
- * which it utilizes (and modifies) in order to perform  *
- * register allocation.                                  *
+ * which it utilizes in order to perform register        *
+ * allocation, and then emits the allocated code.        *
  *                                                       *
  * Run with [-h --help] option for additional info.      *
  *                                                       *
@@ -16,19 +18,11 @@
  *                                                       *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
-#define MIN_ARGS 2
-#define MAX_ARGS 5
 #define MIN_REGS 3
 #define DEFAULT 5
 
 #include "allocator.h"
-#include <cstring>	// strcmp()
-
-using std::strcmp;
-
-// helper function prototypes
-bool validFile(string filename);
-void printCode(list<Instruction>& ir);
+#include "irfile.h"
 
 
 /// main ///
@@ -37,8 +31,18 @@ int main(int argc, char* argv[]) {
 	int k = INVALID;
 	bool printTokens = false;	// -t
 	bool printDebug = false;	// -p
-	string usage = "usage: reader [-t] [-p] [-h --help] [-k num] <filename>\n"
+	string irfile = "";			// --emit-ir
+	string mode = "";			// -m
+	int threads = INVALID;		// -j
+	bool report = false;		// -r
+	int window = INVALID;		// -w
+	string policy = "";			// -a
+	string level = "";			// -O
+	string usage = "usage: alloc [-t | -p] [-h --help] [-k num] [-m mode] [-j num] [-r]\n"
+					"             [-w num] [-a policy] [-O level]\n"
+					"             [--emit-ir irfile] [<filename>]\n"
 					"where: <filename> is the name of the file to be compiled\n"
+					"       (stdin if it is \'-\' or omitted)\n"
 					"       and brackets indicate program options.\n"
 					"		invoke the help option for further details.";
 	string help = "\n"
@@ -49,7 +53,9 @@ int main(int argc, char* argv[]) {
 		"IR is then passed to an allocator that allocates a specified number\n"
 		"of the target machine's physical registers to the registers in the\n"
 		"source code.\n\n"
-		"usage: reader [-t] [-p] [-h --help] [-k num] <filename>\n\n"
+		"usage: alloc [-t | -p] [-h --help] [-k num] [-m mode] [-j num] [-r]\n"
+		"             [-w num] [-a policy] [-O level]\n"
+		"             [--emit-ir irfile] [<filename>]\n\n"
 		"Program arguments:\n"
 		"      -t   prints a list of the tokens scanned, each on its own line.\n"
 		"           tokens are of the form <TOKEN_TYPE, lexeme>\n"
@@ -60,273 +66,315 @@ int main(int argc, char* argv[]) {
 		"      -h   help option. prints this help summary and exits the simulation.\n"
 		"           --help is the verbose form of this option.\n"
 		"  -k num   allows the user to specify the number of physical registers\n"
-		"           to be allocated. if not specified, defaults to 10.\n"
+		"           to be allocated. if not specified, defaults to 5.\n"
+		" -m mode   chooses how blocks are allocated. mode is one of:\n"
+		"             exact     one pass over the block (the default)\n"
+		"             parallel  large blocks are split where few values are\n"
+		"                       live, and the pieces are allocated on\n"
+		"                       threads at once. values live across a split\n"
+		"                       go through memory, which may cost cycles.\n"
+		"             stream    the same code as exact, but the block is\n"
+		"                       kept in a temporary file and allocated a\n"
+		"                       piece at a time, so memory does not grow\n"
+		"                       with its length (IR files are read whole).\n"
+		"                       a block longer than a piece may differ:\n"
+		"                       loads are not moved up across pieces, and\n"
+		"                       if it reads registers it never sets, one\n"
+		"                       is kept for spilling throughout.\n"
+		"                       can't be combined with -p.\n"
+		"             online    each instruction is allocated, and written\n"
+		"                       out, once the next few (see -w) have been\n"
+		"                       read, knowing nothing beyond them. this may\n"
+		"                       cost cycles: a value is kept until its\n"
+		"                       register is set again, so one that is never\n"
+		"                       used again may still be stored (a long\n"
+		"                       chain of values used once costs a store\n"
+		"                       each). can't be combined with -p.\n"
+		"  -j num   uses at most num threads. if not specified, uses one per\n"
+		"           core. results do not depend on it, except in parallel mode.\n"
+		"      -r   reports the estimated cycles taken by the allocated code\n"
+		"           (and in parallel mode, the difference from exact mode)\n"
+		"           on stderr.\n"
+		"  -w num   number of instructions online mode looks ahead. if not\n"
+		"           specified, defaults to 64.\n"
+		"-a policy  chooses which register is spilled when none is free.\n"
+		"           policy is one of:\n"
+		"             cost      the one whose spill code costs fewest\n"
+		"                       cycles for how far off its next use is\n"
+		"                       (the default)\n"
+		"             clean     a rematerializable one if there is one,\n"
+		"                       otherwise the one used furthest off, with\n"
+		"                       ties going to clean ones\n"
+		"             belady    the one used furthest off\n"
+		"             uses      as clean, but by how far off its next use\n"
+		"                       is over how many uses it has left\n"
+		"-O level   how hard to look for the cheapest code. level is one of:\n"
+		"             heuristic victims are picked by -a (the default)\n"
+		"             optimal   every choice of victims is searched for the\n"
+		"                       one whose spill code takes the fewest cycles,\n"
+		"                       until a budget runs out (then the best found\n"
+		"                       so far is used). it is kept only if the code\n"
+		"                       is also faster than -a's, counting the stalls\n"
+		"                       the simulator would make (as far as it can be\n"
+		"                       told without the block's input). meant for\n"
+		"                       small blocks; exact mode only.\n"
+		"--emit-ir irfile\n"
+		"           writes the parsed block to irfile in binary IR form and\n"
+		"           exits without allocating. alloc accepts an IR file in\n"
+		"           place of ILOC code, which skips scanning and parsing.\n"
 		"filename   the name of a file containing ILOC code to be compiled.\n"
-		"           unless the help option is invoked, this will always be the\n"
-		"           last option.\n\n"
-		"One option is permitted in addition to [-k num], but must precede it.\n"
+		"           if it is \'-\' or omitted, the code is read from stdin,\n"
+		"           which may be a pipe. if present, it must be the last\n"
+		"           argument.\n\n"
+		"Options may be given in any order, but [-t] and [-p] are exclusive.\n"
 		"If neither [-t] nor [-p] are invoked, the legal ILOC code generated\n"
-		"from the IR will be printed upon completion of allocation.\n";
-		
+		"from the IR will be written to stdout upon completion of allocation.\n";
+
 
-	// ensure correct number of arguments
-	if (argc < MIN_ARGS) {
-		cerr << "error: not enough arguments"
-			<< endl << usage << endl;
-		return 1;
-	} else if (argc > MAX_ARGS) {
-		cerr << "error: too many arguments"
-			<< endl << usage << endl;
-		return 1;
 	// parse arguments
-	} else {
+	for (int a = 1; a < argc; ++a) {
+		string arg = argv[a];
 		// parse -h & --help
-		if (strcmp(argv[1], "-h") == 0 ||
-			strcmp(argv[1], "--help") == 0) {
-				cout << help << endl;
-				return 0;
+		if (arg == "-h" || arg == "--help") {
+			cout << help << endl;
+			return 0;
 		// parse -t
-		} else if (strcmp(argv[1], "-t") == 0)
+		} else if (arg == "-t" && !printDebug)
 			printTokens = true;
 		// parse -p
-		else if (strcmp(argv[1], "-p") == 0)
+		else if (arg == "-p" && !printTokens)
 			printDebug = true;
 		// parse -k num
-		else if (strcmp(argv[1], "-k") == 0) {
+		else if (arg == "-k" && k == INVALID) {
+			// ensure has another argument
+			if (++a == argc) {
+				cerr << "error: missing number of registers"
+					<< endl << usage << endl;
+				return 1;
+			}
 			// parse num
 			try {
-				k = stoi(string(argv[2]));
+				k = stoi(string(argv[a]));
 				if (k < MIN_REGS)
 					throw INVALID;
 			} catch (...) {
 				cerr << "error: invalid number of registers: "
-					<< argv[2] << endl << usage << endl;
+					<< argv[a] << endl << usage << endl;
 				return 1;
 			}
+		// parse -m mode
+		} else if (arg == "-m" && mode == "") {
 			// ensure has another argument
-			if (argc == 3) {
-				cerr << "error: missing filename"
+			if (++a == argc) {
+				cerr << "error: missing allocation mode"
 					<< endl << usage << endl;
 				return 1;
 			}
-		// parse filename for argc == 2
-		} else if (validFile(argv[1]))
-			infile = argv[1];
-		// bad filename
-		else if (argc == 2) {
-			cerr << "error: invalid filename: " 
-				<< argv[1] << endl << usage << endl;
-			return 1;
-		// bad argument
-		} else {
-			cerr << "error: invalid argument: "
-				<< argv[1] << endl << usage << endl;
-			return 1;
-		}
-
-		// parse for argc == 3
-		// argv[2] must be filename
-		if (argc == 3) {
-			// check if already parsed filename
-			if (infile == "") {
-				// parse filename
-				if (validFile(argv[2]))
-					infile = argv[2];
-				// bad filename
-				else {
-					cerr << "error: invalid filename: " 
-						<< argv[2] << endl << usage << endl;
-					return 1;
-				}
-			// excess arguments
-			} else {
-				cerr << "error: invalid argument(s) following filename"
+			mode = argv[a];
+			if (mode != "exact" && mode != "parallel" && mode != "stream"
+														&& mode != "online") {
+				cerr << "error: invalid allocation mode: "
+					<< mode << endl << usage << endl;
+				return 1;
+			}
+		// parse -j num
+		} else if (arg == "-j" && threads == INVALID) {
+			// ensure has another argument
+			if (++a == argc) {
+				cerr << "error: missing number of threads"
 					<< endl << usage << endl;
 				return 1;
 			}
-		}
-
-		// parse for argc == 4
-		// would already have parsed -k num
-		if (argc == 4) {
-			// ensure -k num is in fact what was already parsed
-			if (printTokens || printDebug || k == INVALID) {
-				cerr << "error: invalid number of arguments"
+			// parse num
+			try {
+				threads = stoi(string(argv[a]));
+				if (threads < 1)
+					throw INVALID;
+			} catch (...) {
+				cerr << "error: invalid number of threads: "
+					<< argv[a] << endl << usage << endl;
+				return 1;
+			}
+		// parse -w num
+		} else if (arg == "-w" && window == INVALID) {
+			// ensure has another argument
+			if (++a == argc) {
+				cerr << "error: missing lookahead window"
 					<< endl << usage << endl;
 				return 1;
 			}
-			// check if already parsed filename
-			if (infile == "") {
-				// parse filename
-				if (validFile(argv[3]))
-					infile = argv[3];
-				// bad filename
-				else {
-					cerr << "error: invalid filename: " 
-						<< argv[3] << endl << usage << endl;
-					return 1;
-				}
-			// excess arguments
-			} else {
-				cerr << "error: invalid argument(s) following filename"
+			// parse num
+			try {
+				window = stoi(string(argv[a]));
+				if (window < 0)
+					throw INVALID;
+			} catch (...) {
+				cerr << "error: invalid lookahead window: "
+					<< argv[a] << endl << usage << endl;
+				return 1;
+			}
+		// parse -a policy
+		} else if (arg == "-a" && policy == "") {
+			// ensure has another argument
+			if (++a == argc) {
+				cerr << "error: missing spill policy"
 					<< endl << usage << endl;
 				return 1;
 			}
-		}
-
-		// parse for argc == 5
-		// must be -k num filename
-		if (argc == 5) {
-			// check if already parsed filename
-			if (infile == "") {
-				// check if already parsed -k num
-				if (k != INVALID) {
-					cerr << "error: invalid (order of) argument(s)"
-						<< endl << usage << endl;
-					return 1;
-				} else {
-					// parse -k num
-					if (strcmp(argv[2], "-k") == 0) {
-						// parse num
-						try {
-							k = stoi(string(argv[3]));
-							if (k < MIN_REGS)
-								throw INVALID;
-						} catch (...) {
-							cerr << "error: invalid number of registers: "
-								<< argv[3] << endl << usage << endl;
-							return 1;
-						}
-					// bad argument
-					} else {
-						cerr << "error: invalid argument: "
-							<< argv[2] << endl << usage << endl;
-						return 1;
-					}
-				}
-				// parse filename
-				if (validFile(argv[4]))
-					infile = argv[4];
-				// bad filename
-				else {
-					cerr << "error: invalid filename: "
-						<< argv[4] << endl << usage << endl;
-					return 1;
-				}
+			policy = argv[a];
+			if (policy != "cost" && policy != "clean" && policy != "belady"
+														&& policy != "uses") {
+				cerr << "error: invalid spill policy: "
+					<< policy << endl << usage << endl;
+				return 1;
+			}
+		// parse -O level
+		} else if (arg == "-O" && level == "") {
+			// ensure has another argument
+			if (++a == argc) {
+				cerr << "error: missing optimization level"
+					<< endl << usage << endl;
+				return 1;
+			}
+			level = argv[a];
+			if (level != "heuristic" && level != "optimal") {
+				cerr << "error: invalid optimization level: "
+					<< level << endl << usage << endl;
+				return 1;
+			}
+		// parse -r
+		} else if (arg == "-r")
+			report = true;
+		// parse --emit-ir irfile
+		else if (arg == "--emit-ir" && irfile == "") {
+			// ensure has another argument
+			if (++a == argc) {
+				cerr << "error: missing IR filename"
+					<< endl << usage << endl;
+				return 1;
+			}
+			irfile = argv[a];
+		// parse filename ("-" is stdin)
+		} else if (arg == "-" || arg[0] != '-') {
 			// excess arguments
-			} else {
+			if (a != argc - 1) {
 				cerr << "error: invalid argument(s) following filename"
 					<< endl << usage << endl;
 				return 1;
 			}
+			infile = arg;
+		// bad argument
+		} else {
+			cerr << "error: invalid argument: "
+				<< arg << endl << usage << endl;
+			return 1;
 		}
-
 	}
 
 	// ensure k is valid number of registers
 	if (k < 0)
 		k = DEFAULT;
+	// one thread per core unless told otherwise
+	if (threads < 0)
+		threads = 0;
+	bool parallel = mode == "parallel";
+	bool streamed = mode == "stream";
+	bool online = mode == "online";
+	bool optimal = level == "optimal";
+	if (window < 0)
+		window = WINDOW;
+	// the whole block is never in memory to print
+	if ((streamed || online) && printDebug) {
+		cerr << "error: -p can't be used in " << mode << " mode"
+			<< endl << usage << endl;
+		return 1;
+	}
 
-	// create Allocator
-	// all allocation occurs in constructor
-	Allocator allocator {infile, k, printTokens};
-
-	// produce output
-	if (printDebug && !printTokens)
-		cerr << allocator;
-	printCode(allocator.intRep);
-
-	return 0;
-}
-
-
-// tests for valid file
-bool validFile(string filename) {
-	bool valid = false;
-	ifstream f(filename);
-	if (f) {
-		valid = true;
-		f.close();
+	// the search allocates the whole block over and over
+	if (optimal && mode != "" && mode != "exact") {
+		cerr << "error: -O optimal can't be used in " << mode << " mode"
+			<< endl << usage << endl;
+		return 1;
 	}
-	return valid;
-}
 
+	// open input (exactly once; stdin if no filename),
+	// a window at a time in stream and online modes
+	Input in {infile == "" ? "-" : infile, streamed || online};
+	if (!in.good()) {
+		cerr << "error: invalid filename: "
+			<< infile << endl << usage << endl;
+		return 1;
+	}
 
-// print generated legal ILOC code
-void printCode(list<Instruction>& ir) {
-	list<Instruction>::iterator it = ir.begin();
-	while (it != ir.end()) {
-		// set cout vars for opcode
-		cout << setw(10) << left;
-		// print opcode
-		switch (it->op) {
-			case load:
-				cout << "load";
-				break;
-			case loadI:
-				cout << "loadI";
-				break;
-			case store:
-				cout << "store";
-				break;
-			case add:
-				cout << "add";
-				break;
-			case sub:
-				cout << "sub";
-				break;
-			case mult:
-				cout << "mult";
-				break;
-			case lshift:
-				cout << "lshift";
-				break;
-			case rshift:
-				cout << "rshift";
-				break;
-			case output:
-				cout << "output";
-				break;
-			case nop:
-				cout << "nop" << endl;
-				++it;
-				continue;
-			default:
-				cout << "uh oh... somethin' done goofed.";
-				break;
-		}
+	// write IR file instead of allocating
+	if (irfile != "") {
+		IR ir;
+		RegisterNames names;
+		Parser {in, ir, names, printTokens, threads};
+		writeIRFile(irfile, ir, names);
+		return 0;
+	}
 
-		// print op1 register
-		if (it->src1.isReg && it->src1.pr != INVALID)
-			cout << "r" << setw(9) << left << it->src1.pr;
-		else if (it->src1.sr != INVALID) {
-			cout << setw(10) << left << it->src1.sr;
-			if (it->op == output) {
-				cout << endl;
-				++it;
-				continue;
+	// scan, parse and allocate block, and produce output
+	// (which stream and online modes write as they go)
+	AllocationContext context;
+	long heuristic = 0;			// cycles before searching (-O optimal)
+	bool proven = false;		// search covered every choice
+	if (policy == "clean")
+		context.setPolicy(cleanFirst);
+	else if (policy == "belady")
+		context.setPolicy(belady);
+	else if (policy == "uses")
+		context.setPolicy(useCount);
+	if (streamed)
+		context.stream(in, cout, k, printTokens);
+	else if (online) {
+		// feed in each instruction as soon as it is parsed
+		// (an IR file is handed over whole)
+		IR ir;
+		RegisterNames names;
+		context.start(cout, k, window);
+		Parser {in, ir, names, printTokens, 1, [&] (IR& some) {
+			for (int i = 0; i < some.size(); ++i) {
+				int s[3];
+				for (int slot = src1Slot; slot <= destSlot; ++slot)
+					s[slot] = some.isReg(i, slot)
+								? names.name(some.sr[3*i + slot])
+								: some.sr[3*i + slot];
+				context.feed(some.op[i], s[src1Slot], s[src2Slot],
+															s[destSlot]);
 			}
+		}};
+		context.finish();
+	} else {
+		context.allocate(in, k, printTokens, threads, parallel);
+		if (optimal) {
+			heuristic = context.cycles();
+			proven = context.optimize();
 		}
+		if (printDebug && !printTokens)
+			cerr << context;
+		context.emit(cout);
+	}
 
-		// print op2 register
-		if (it->op != store && it->src2.pr != INVALID)
-			cout << ",  r" << setw(6) << left << it->src2.pr;
-		else
-			cout << setw(10) << "";
-
-		// print arrow
-		cout << "=>   ";
-
-		//print op3 register
-		if (it->dest.pr != INVALID)
-			cout << "r" << it->dest.pr;
-		if (it->op == store)
-			cout << "r" << it->src2.pr;
-
-		// print new line
-		cout << endl;
-		// increment iterator
-		++it;
+	// report cycles (allocating again in exact mode to compare,
+	// or against the heuristic when searching)
+	if (report) {
+		long cycles = context.cycles();
+		cerr << "// cycles: " << cycles;
+		if (parallel) {
+			int lanes = context.lanes();
+			context.reallocate(false);
+			long exact = context.cycles();
+			cerr << " in " << lanes << " lanes (exact: " << exact
+				<< ", difference: " << cycles - exact << ")";
+		}
+		if (optimal)
+			cerr << " (heuristic: " << heuristic << ", difference: "
+				<< cycles - heuristic << ", search "
+				<< (proven ? "finished" : "cut off") << ")";
+		cerr << endl;
 	}
-}
 
+	return 0;
+}
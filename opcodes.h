@@ -0,0 +1,169 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                       *
+ * opcodes.h                                             *
+ *                                                       *
+ * Contains declarations for Opcode enumeration and the  *
+ * compile-time table describing each Opcode: its        *
+ * mnemonic, the shape of its operands (which are        *
+ * registers or constants, how they are separated, and   *
+ * which are uses and definitions), and its latency.     *
+ *                                                       *
+ * Mnemonics are recognized with a perfect hash of their *
+ * first character and length, checked at compile time. *
+ *                                                       *
+ * Written by: Austin James Lee                          *
+ *                                                       *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#pragma once
+
+#define NUM_OPCODES 10
+#define MAX_MNEMONIC 6	// length of longest mnemonic
+#define HASH_SIZE 16	// slots in opTable (power of 2)
+#define NO_OPCODE -1	// returned when lookup fails
+
+
+////// Enumerations //////
+
+
+/// Opcodes (one byte each, so IR opcode arrays are dense) ///
+enum Opcode : unsigned char {
+	load,
+    loadI,
+    store,
+    add,
+    sub,
+    mult,
+    lshift,
+    rshift,
+    output,
+    nop
+};
+
+
+/// Operand kinds ///
+enum Kind {
+	noArg,		// operand not present
+	regArg,		// register
+	constArg	// numerical constant
+};
+
+
+/// Separator written before an operand ///
+enum Sep {
+	noSep,
+	commaSep,	// ','
+	arrowSep	// "=>"
+};
+
+
+/// Operand slots of an Instruction ///
+enum Slot {
+	src1Slot,
+	src2Slot,
+	destSlot
+};
+
+
+////// Opcode descriptor table //////
+
+
+/// Operand structure ///
+// register operands in src1Slot and src2Slot are uses;
+// a register operand in destSlot is a definition.
+struct Operand {
+	Kind kind;
+	Sep sep;
+};
+
+
+/// OpInfo structure ///
+struct OpInfo {
+	const char* name;	// mnemonic
+	int len;			// length of mnemonic
+	Operand args[3];	// operands, indexed by Slot, in the order written
+	int latency;		// cycles until result is available
+};
+
+
+// indexed by Opcode
+constexpr OpInfo opInfo[NUM_OPCODES] = {
+	{"load",   4, {{regArg, noSep},   {noArg, noSep},     {regArg, arrowSep}}, 3},
+	{"loadI",  5, {{constArg, noSep}, {noArg, noSep},     {regArg, arrowSep}}, 1},
+	{"store",  5, {{regArg, noSep},   {regArg, arrowSep}, {noArg, noSep}},     3},
+	{"add",    3, {{regArg, noSep},   {regArg, commaSep}, {regArg, arrowSep}}, 1},
+	{"sub",    3, {{regArg, noSep},   {regArg, commaSep}, {regArg, arrowSep}}, 1},
+	{"mult",   4, {{regArg, noSep},   {regArg, commaSep}, {regArg, arrowSep}}, 1},
+	{"lshift", 6, {{regArg, noSep},   {regArg, commaSep}, {regArg, arrowSep}}, 1},
+	{"rshift", 6, {{regArg, noSep},   {regArg, commaSep}, {regArg, arrowSep}}, 1},
+	{"output", 6, {{constArg, noSep}, {noArg, noSep},     {noArg, noSep}},     1},
+	{"nop",    3, {{noArg, noSep},    {noArg, noSep},     {noArg, noSep}},     1}
+};
+
+
+// returns true if operand s of op is a register that is used
+constexpr bool isUse(Opcode op, Slot s) {
+	return s != destSlot && opInfo[op].args[s].kind == regArg;
+}
+
+
+// returns true if op defines a register
+constexpr bool isDef(Opcode op) {
+	return opInfo[op].args[destSlot].kind == regArg;
+}
+
+
+////// Perfect hash of mnemonics //////
+
+
+// hash of a mnemonic's first character and length.
+// distinct for every mnemonic (checked below).
+constexpr int opHash(char c, int len) {
+	return (c + 3 * len) & (HASH_SIZE - 1);
+}
+
+
+/// OpTable structure ///
+// maps opHash() of a mnemonic to its Opcode.
+struct OpTable {
+	int slot[HASH_SIZE];
+};
+
+
+// builds OpTable at compile time
+constexpr OpTable makeOpTable() {
+	OpTable t {};
+	for (int i = 0; i < HASH_SIZE; ++i)
+		t.slot[i] = NO_OPCODE;
+	for (int op = 0; op < NUM_OPCODES; ++op)
+		t.slot[opHash(opInfo[op].name[0], opInfo[op].len)] = op;
+	return t;
+}
+
+constexpr OpTable opTable = makeOpTable();
+
+
+// true if no two mnemonics share a slot
+constexpr bool isPerfect() {
+	for (int op = 0; op < NUM_OPCODES; ++op)
+		if (opTable.slot[opHash(opInfo[op].name[0], opInfo[op].len)] != op)
+			return false;
+	return true;
+}
+
+static_assert(isPerfect(), "opHash() is not a perfect hash of mnemonics");
+
+
+// returns Opcode spelled by the len characters at s,
+// or NO_OPCODE if they do not spell a mnemonic.
+constexpr int lookupOpcode(const char* s, int len) {
+	if (len < 1 || len > MAX_MNEMONIC)
+		return NO_OPCODE;
+	int op = opTable.slot[opHash(s[0], len)];
+	if (op == NO_OPCODE || opInfo[op].len != len)
+		return NO_OPCODE;
+	for (int i = 0; i < len; ++i)
+		if (s[i] != opInfo[op].name[i])
+			return NO_OPCODE;
+	return op;
+}
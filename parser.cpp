@@ -3,212 +3,212 @@
  * parser.cpp                                            *
  *                                                       *
  * Contains implementations for everything in parser.h.  *
- * Methods appear in same order as they do in parser.h   *
- * with the exception of Instruction's print function,   *
- * which is at the end of the file.                      *
+ * Methods appear in same order as they do in parser.h.  *
  *                                                       *
  * Written by: Austin James Lee                          *
  *                                                       *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "parser.h"
-
-
-//// Register constructors ////
-
-
-// constructor for Instruction.src1
-Register::Register(bool o)
-		:sr{INVALID}, isReg{false}, isOp1{o},
-		vr{INVALID}, pr{INVALID}, nu{INVALID} {}
-
-
-// default constructor
-// all arguments declared with defaults
-Register::Register(int s, bool r, bool o, int v, int p, int n)
-					:sr{s}, isReg{r}, isOp1{o}, vr{v}, pr{p}, nu{n} {}
-
-
-//// Instruction constructor ////
-
-
-// overloaded constructor
-Instruction::Instruction(Opcode o, Register s1, Register s2, Register d)
-			:op{o}, src1{s1}, src2{s2}, dest{d} {}
-
+#include "irfile.h"
 
 
 //// Parser methods ////
 
 
 // constructor (public)
-// takes file name and "scanner print" bool to construct Scanner,
-Parser::Parser(string infile, bool sp) :scanner{infile, sp} {
-	// parse until EOF or error
-	parse();
+// takes input and "scanner print" bool to construct Scanner,
+// IR and RegisterNames to add instructions and their register
+// names to (so callers can reuse them for block after block),
+// and maximum number of threads to parse with.
+// large inputs are split into chunks that are parsed in parallel,
+// unless tokens are to be printed (they must be printed in order)
+// or input is streamed (it is not all available up front).
+// IR files (see irfile.h) are loaded directly instead of parsed.
+Parser::Parser(Input& in, IR& ir, RegisterNames& names, bool sp, int threads)
+					:intRep{ir}, regNames{names}, input{in}, chunk{0} {
+	input.extend(sizeof(IRHeader));
+	if (isIRFile(input.begin(), input.end())) {
+		loadIR();
+		return;
+	}
+	if (threads <= 0)
+		threads = thread::hardware_concurrency();
+	int n = min<size_t>(threads, input.size() / CHUNK_MIN);
+	if (n > 1 && !sp && !input.streaming())
+		parseChunks(n);
+	else {
+		// parse until EOF or error
+		Scanner s {input, sp};
+		parse(s, intRep, regNames);
+	}
 }
 
 
-// main parse function (private; called from constructor)
-// requests an instruction token, then builds an
-// Instruction based on its Opcode and adds it to the
-// end of the intermediate representation (intRep)
-void Parser::parse() {
-	// scan next Instruction
-	Token t = scanner.scanInstruction();
-	// check for EOF (only time Invalid Token is returned)
-	if (t.cat == INVALID)
-		return;
-
-	Instruction i {(Opcode)t.value};
-	switch (i.op) {
-
-		case load:
-			i.src1 = Register {(scanner.scanRegister()).value, true, true};
-			scanner.scanArrow();
-			i.dest = Register {(scanner.scanRegister()).value, true};
-			break;
-
-		case loadI:
-			i.src1 = Register {(scanner.scanConstant()).value, false, true};
-			scanner.scanArrow();
-			i.dest = Register {(scanner.scanRegister()).value, true};
-			break;
-
-		case store:
-			i.src1 = Register {(scanner.scanRegister()).value, true, true};
-			scanner.scanArrow();
-			i.src2 = Register {(scanner.scanRegister()).value, true};
-			break;
-
-		case output:
-			i.src1 = Register {(scanner.scanConstant()).value, false, true};
-			break;
-
-		case nop:
-			break;
-
-		// arithmetic operations
-		default:
-			i.src1 = Register {(scanner.scanRegister()).value, true, true};
-			scanner.scanComma();
-			i.src2 = Register {(scanner.scanRegister()).value, true};
-			scanner.scanArrow();
-			i.dest = Register {(scanner.scanRegister()).value, true};
-			break;
+// constructor (public)
+// parses block from in, as the constructor above does on one
+// thread, but hands intRep to full every chunk instructions, so
+// that only chunk instructions are held at once. an IR file is
+// loaded all at once, and handed to full whole.
+Parser::Parser(Input& in, IR& ir, RegisterNames& names, bool sp,
+							int c, function<void(IR&)> full)
+					:intRep{ir}, regNames{names}, input{in},
+					chunk{c}, flush{full} {
+	input.extend(sizeof(IRHeader));
+	if (isIRFile(input.begin(), input.end()))
+		loadIR();
+	else {
+		Scanner s {input, sp};
+		parse(s, intRep, regNames);
+	}
+	if (intRep.size() > 0) {
+		flush(intRep);
+		intRep.clear();
 	}
+}
 
-	// add Instruction to end of IR
-	intRep.push_back(i);
 
-	// continue parsing
-	parse();
+// loads IR file (private; called from constructor)
+// a mapped or read file is used in place. streamed input is
+// gathered first, since refilling only keeps the current window.
+void Parser::loadIR() {
+	if (!input.streaming()) {
+		readIRFile(input.name(), input.begin(), input.end(),
+											intRep, regNames);
+		return;
+	}
+	vector<char> all (input.begin(), input.end());
+	while (input.refill())
+		all.insert(all.end(), input.begin(), input.end());
+	readIRFile(input.name(), all.data(), all.data() + all.size(),
+											intRep, regNames);
 }
 
 
-
-//// struct overloaded << print function ////
-
-
-
-// Register pretty print
-// first sr field for an instruction: 12 spaces
-//	- up to INT_MAX with 1 space padding
-// all other register fields: 6 spaces
-//	- register value up to 1000 with 1 space padding
-ostream& operator<<(ostream& os, const Register& r) {
-	string noReg = "  -   ";
-	// print source register
-	if (r.sr == INVALID) {
-		os << noReg;
-		if (r.isOp1)
-			os << "      ";
-	} else if (r.isReg) {
-		os << " r";
-		// set field width
-		if (r.isOp1)
-			os << setw(10);
-		else
-			os << setw(4);
-		os << left << r.sr;
-	} else
-		os << " " << setw(11) << left << r.sr;
-	os << "|";
-
-	// print virtual register
-	if (r.vr == INVALID)
-		os << noReg;
-	else
-		os << " v" << setw(4) << left << r.vr;
-	os << "|";
-
-	// print physical register
-	if (r.pr == INVALID)
-		os << noReg;
-	else
-		os << " r" << setw(4) << left << r.pr;
-	os << "|";
-
-	// print next use
-	if (r.nu == INVALID)
-		os << noReg;
-	else if (r.nu == INT_MAX)
-		os << " INF  ";
-	else
-		os << " " << setw(5) << left << r.nu;
-	os << "||";
-
-	return os;
+// main parse function (private; called from constructor)
+// requests instruction opcodes until EOF, scanning operands
+// in the shape opInfo gives each Opcode, and adding the
+// instruction to the end of the intermediate representation
+// (ir), which is handed to flush whenever it holds chunk
+// instructions. source registers are renamed by names.
+// iterates rather than recursing, so stack depth
+// does not grow with the size of the block.
+void Parser::parse(Scanner& scanner, IR& ir, RegisterNames& names) {
+	int op;
+	// scan next instruction until EOF (only time INVALID is returned)
+	while ((op = scanner.scanInstruction()) != INVALID) {
+		int sr[] = {INVALID, INVALID, INVALID};
+		// scan operands in the shape given by opInfo
+		for (int slot = src1Slot; slot <= destSlot; ++slot) {
+			const Operand& arg = opInfo[op].args[slot];
+			if (arg.kind == noArg)
+				continue;
+			if (arg.sep == commaSep)
+				scanner.scanComma();
+			else if (arg.sep == arrowSep)
+				scanner.scanArrow();
+			if (arg.kind == regArg)
+				sr[slot] = names.rename(scanner.scanRegister());
+			else
+				sr[slot] = scanner.scanConstant();
+		}
+
+		// add instruction to end of IR
+		ir.add((Opcode)op, sr[src1Slot], sr[src2Slot], sr[destSlot]);
+		// hand over full chunk
+		if (ir.size() == chunk) {
+			flush(ir);
+			ir.clear();
+		}
+	}
 }
 
 
-// Instruction pretty print
-// opcode field: 8
-//	- max opcode is 6 chars + 1 space of padding
-ostream& operator<<(ostream& os, const Instruction& i) {
-	// set ostream variables
-	os << " " << setw(7) << left;
-	// print Opcode
-	switch (i.op) {
-		case load:
-			os << "load";
-			break;
-		case loadI:
-			os << "loadI";
-			break;
-		case store:
-			os << "store";
-			break;
-		case add:
-			os << "add";
-			break;
-		case sub:
-			os << "sub";
-			break;
-		case mult:
-			os << "mult";
-			break;
-		case lshift:
-			os << "lshift";
-			break;
-		case rshift:
-			os << "rshift";
-			break;
-		case output:
-			os << "output";
-			break;
-		case nop:
-			os << "nop";
-			break;
-		default:
-			os << "no es bueno";
-			break;
+// splits input into n chunks at new line boundaries and parses
+// each on its own thread into its own IR, then copies the IRs
+// onto the end of intRep in order. each chunk but the first begins with the
+// new line ending the previous chunk, so each is scanned exactly
+// as it would be by a single Scanner.
+//
+// each chunk names its registers on its own. the names of later
+// chunks are then translated into the first chunk's, in order,
+// which numbers registers exactly as a single pass would have.
+//
+// Scanners for chunks do not terminate on errors. if any chunk
+// fails, the first one to fail is parsed again, by a Scanner that
+// runs to the end of input, to report the error exactly as
+// parsing on a single thread would have.
+void Parser::parseChunks(int n) {
+	// find chunk boundaries
+	vector<const char*> bounds {input.begin()};
+	for (int i = 1; i < n; ++i) {
+		const char* b = input.begin() + input.size() / n * i;
+		if (b < bounds.back())
+			b = bounds.back();
+		b = findNL(b, input.end());
+		if (b != input.end() && b != bounds.back())
+			bounds.push_back(b);
+	}
+	bounds.push_back(input.end());
+	n = bounds.size() - 1;
+
+	// parse each chunk (the first on this thread, into regNames)
+	vector<IR> irs (n);
+	vector<RegisterNames> names (n);
+	vector<char> failed (n, false);	// not vector<bool>: written concurrently
+	auto work = [&] (int i) {
+		Scanner s {input.name(), input.begin(), bounds[i], bounds[i+1],
+															false, false};
+		try {
+			parse(s, irs[i], i == 0 ? regNames : names[i]);
+		} catch (...) {
+			failed[i] = true;
+		}
+	};
+	vector<thread> workers;
+	for (int i = 1; i < n; ++i)
+		workers.push_back(thread {work, i});
+	work(0);
+	for (thread& t : workers)
+		t.join();
+
+	// translate names of chunks in order, up to the first failed
+	// chunk, and find where each chunk starts in intRep
+	int good = 0;
+	vector<vector<int>> trans (n);
+	vector<int> start {0};
+	for (; good < n && !failed[good]; ++good) {
+		for (int r = 0; good > 0 && r < names[good].size(); ++r)
+			trans[good].push_back(regNames.rename(names[good].name(r)));
+		start.push_back(start.back() + irs[good].size());
 	}
-	os << "|||";
-
-	// print registers!
-	os << i.src1 << i.src2 << i.dest;
 
-	return os;
+	// copy each chunk onto the end of intRep on its own
+	// thread, renaming registers of all but the first
+	int base = intRep.size();
+	intRep.resize(base + start[good]);
+	auto place = [&] (int i) {
+		const IR& ir = irs[i];
+		copy(ir.op.begin(), ir.op.end(), intRep.op.begin() + base + start[i]);
+		for (int j = 0; j < ir.size(); ++j)
+			for (int slot = src1Slot; slot <= destSlot; ++slot) {
+				int sr = ir.sr[3*j + slot];
+				if (i > 0 && ir.isReg(j, slot))
+					sr = trans[i][sr];
+				intRep.sr[3*(base + start[i] + j) + slot] = sr;
+			}
+	};
+	workers.clear();
+	for (int i = 1; i < good; ++i)
+		workers.push_back(thread {place, i});
+	if (good > 0)
+		place(0);
+	for (thread& t : workers)
+		t.join();
+
+	if (good < n) {
+		// parse the rest of input on this thread (reports error)
+		Scanner s {input.name(), input.begin(), bounds[good], input.end()};
+		parse(s, intRep, regNames);
+	}
 }
-
@@ -2,10 +2,9 @@
  *                                                       *
  * parser.h                                              *
  *                                                       *
- * Contains declarations for Register and Instruction    *
- * structures and Parser class, as well as all necessary *
- * includes and using statements not already present in  *
- * scanner.h.                                            *
+ * Contains declaration for Parser class, as well as all *
+ * necessary includes and using statements not already   *
+ * present in ir.h and scanner.h.                        *
  *                                                       *
  * Written by: Austin James Lee                          *
  *                                                       *
@@ -13,57 +12,47 @@
 
 #pragma once
 
-#include "scanner.h"
-#include <list>
-#include <iomanip>
+// minimum bytes of input per chunk when parsing in parallel
+#define CHUNK_MIN (1 << 18)
 
-using std::list;
-using std::setw;
-using std::left;
+#include "ir.h"
+#include <thread>
+#include <algorithm>	// copy
+#include <functional>	// function
 
-
-//// Register structure ////
-
-struct Register {
-	// constructor. takes bool used to set op1
-	Register(bool o);
-	// constructor. takes values in order they are declared
-	Register(int = INVALID, bool = false, bool = false,
-			int = INVALID, int = INVALID, int = INVALID);
-	int sr;		// source register
-	bool isReg;	// valid register?
-	bool isOp1;	// indicates if src1 (purely for printing)
-	int vr;		// virtual register
-	int pr;		// physical register
-	int nu;		// index of next use of this register
-	// allow for simple and pretty printing
-	friend ostream& operator<<(ostream& os, const Register& r);
-};
-
-
-//// Instruction structure ////
-
-struct Instruction {
-	// constructor. takes values in order listed.
-	Instruction(Opcode = (Opcode)INVALID,
-		Register={true}, Register={}, Register={});
-	Opcode op;				
-	Register src1;
-	Register src2;
-	Register dest;
-	// allow for simple and pretty printing
-	friend ostream& operator<<(ostream& os, const Instruction& i);
-};
+using std::thread;
+using std::copy;
+using std::function;
 
 
 //// Parser class ////
 
 class Parser {
 	public:
-		// constructor (calls parse)
-		Parser(string infile, bool = false);
-		list<Instruction> intRep;	// list representing IR
+		// constructor (calls parse, parseChunks, or loadIR)
+		// takes input, IR and RegisterNames to add the block
+		// to, "scanner print" bool, and max number of threads
+		// (0 picks one per core)
+		Parser(Input& in, IR& ir, RegisterNames& names,
+								bool = false, int = 0);
+		// constructor for blocks too large to hold at once
+		// parses on one thread, handing ir to full (and then
+		// clearing it) each time it holds chunk instructions,
+		// and once more at the end if anything is left
+		Parser(Input& in, IR& ir, RegisterNames& names, bool sp,
+								int chunk, function<void(IR&)> full);
+		IR& intRep;					// intermediate representation
+		RegisterNames& regNames;	// source names of registers in intRep
 	private:
-		Scanner scanner;	// Scanner used to scan tokens
-		void parse();		// main parse function
+		Input& input;		// contents of input file
+		int chunk;			// instructions handed to flush at once (0: all)
+		function<void(IR&)> flush;	// takes each chunk of intRep
+		// main parse function. scans and parses all tokens
+		// from s, adding instructions to ir and renaming
+		// their registers with names
+		void parse(Scanner& s, IR& ir, RegisterNames& names);
+		// builds intRep from an IR file instead of text
+		void loadIR();
+		// splits input into n chunks and parses each on its own thread
+		void parseChunks(int n);
 };
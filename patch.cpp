@@ -0,0 +1,63 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                     *
+ * patch.cpp                                           *
+ *                                                     *
+ * Contains implementations for everything in patch.h. *
+ * Methods appear in same order as they do in patch.h. *
+ *                                                     *
+ * Written by: Austin James Lee                        *
+ *                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "patch.h"
+
+
+//// PatchList methods ////
+
+
+// constructor
+// the arena starts without any chunks.
+PatchList::PatchList() :count{0} {}
+
+
+// adds Patch op (with constant c and physical registers pr1, pr2
+// and pr3) in front of instruction at. a new chunk is allocated
+// only when every chunk already in the arena is full.
+void PatchList::add(int at, Opcode op, int c, int pr1, int pr2, int pr3) {
+	if (count == (int)chunks.size() * PATCH_CHUNK)
+		chunks.emplace_back(new Patch[PATCH_CHUNK]);
+	chunks[count / PATCH_CHUNK][count % PATCH_CHUNK] =
+									Patch {at, op, c, {pr1, pr2, pr3}};
+	++count;
+}
+
+
+// removes the last Patch added (there must be one)
+void PatchList::pop() {
+	--count;
+}
+
+
+// returns number of Patches in list
+int PatchList::size() const {
+	return count;
+}
+
+
+// returns i'th Patch added
+const Patch& PatchList::operator[](int i) const {
+	return chunks[i / PATCH_CHUNK][i % PATCH_CHUNK];
+}
+
+
+// empties list. chunks are kept for the Patches of the next block.
+void PatchList::reset() {
+	count = 0;
+}
+
+
+// exchanges Patches (and chunks) with other
+void PatchList::swap(PatchList& other) {
+	chunks.swap(other.chunks);
+	std::swap(count, other.count);
+}
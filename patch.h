@@ -0,0 +1,64 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                     *
+ * patch.h                                             *
+ *                                                     *
+ * Contains declarations for the Patch structure and   *
+ * PatchList class, which hold the spill and restore   *
+ * code an Allocator adds to a block, as well as all   *
+ * necessary includes and using statements not         *
+ * already present in ir.h and scanner.h.              *
+ *                                                     *
+ * Patches are kept apart from the IR, in the order    *
+ * they are made, each keyed by the index of the       *
+ * instruction it goes in front of. They are merged    *
+ * with the IR only when code is printed, so the IR    *
+ * never changes shape during allocation.              *
+ *                                                     *
+ * Written by: Austin James Lee                        *
+ *                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#pragma once
+
+// number of Patches in each chunk of a PatchList's arena
+#define PATCH_CHUNK 4096
+
+#include "ir.h"
+#include <memory>	// unique_ptr
+
+using std::unique_ptr;
+
+
+//// Patch structure ////
+
+struct Patch {
+	int at;			// index of instruction this goes in front of
+	Opcode op;		// loadI, load or store
+	int c;			// constant operand of loadI (INVALID otherwise)
+	int pr[3];		// physical registers, indexed by slot
+};
+
+
+//// PatchList class ////
+
+// Patches in the order they were added, stored in an arena of
+// fixed size chunks. reset() empties the list but keeps its
+// chunks, so a list that is reused for each block only allocates
+// when a block needs more patches than any block before it.
+class PatchList {
+	public:
+		PatchList();						// constructor (empty list)
+		// adds Patch in front of instruction at (which must not
+		// be before that of the last Patch added)
+		void add(int at, Opcode op, int c, int pr1, int pr2, int pr3);
+		void pop();							// removes last Patch added
+		int size() const;					// number of Patches
+		const Patch& operator[](int i) const;	// i'th Patch added
+		void reset();						// empties list (keeps chunks)
+		void swap(PatchList& other);		// exchanges contents with other
+	private:
+		PatchList(const PatchList&);			// not copyable
+		PatchList& operator=(const PatchList&);	// not assignable
+		vector<unique_ptr<Patch[]>> chunks;	// arena
+		int count;							// number of Patches in use
+};
@@ -32,46 +32,53 @@ Token::Token(TokenCat tc, int v) :cat{tc}, value{v} {}
 
 
 // Scanner default constructor
-Scanner::Scanner() :infile{""}, print{false}, ln{-1}, pos{-1} {}
+Scanner::Scanner()
+		:infile{""}, src{nullptr}, nls{0}, base{nullptr}, cur{nullptr},
+		last{nullptr}, print{false}, fatal{true}, eofReads{0} {}
 
 
 // Scanner constructor
-// takes input file's name and opens ifstream.
+// scans all of in, pulling in each window of streamed input
+// as the previous one is exhausted.
 // also takes bool indicating whether -t option was passed.
-// initializes line to 1 and pos to 0.
-Scanner::Scanner(string f, bool p) :infile{f}, print{p}, ln{1}, pos{0} {
-	input.open(infile);
-}
-
+// line and position are computed from cur only when needed.
+Scanner::Scanner(Input& in, bool p)
+		:infile{in.name()}, src{&in}, nls{0}, base{in.begin()},
+		cur{in.begin()}, last{in.end()}, print{p}, fatal{true}, eofReads{0} {}
 
-// Scanner copy constructor
-Scanner::Scanner(const Scanner& s)
-		:infile{s.infile}, print{s.print}, ln{s.ln}, pos{s.pos} {
-	input.open(infile);
-}
 
-
-// Scanner deconstructor (public)
-// closes ifstream before destroying Scanner object.
-Scanner::~Scanner() {
-	input.close();
-}
+// Scanner range constructor
+// takes input file's name and the range of its contents,
+// [b, e), to be scanned. base is the start of the whole file,
+// so line numbers are correct when scanning part of a file.
+// also takes bool indicating whether -t option was passed, and
+// bool indicating whether errors terminate the program.
+// line and position are computed from cur only when needed.
+Scanner::Scanner(string f, const char* bs, const char* b, const char* e,
+															bool p, bool x)
+		:infile{f}, src{nullptr}, nls{0}, base{bs}, cur{b}, last{e},
+		print{p}, fatal{x}, eofReads{0} {}
 
 
 // scans and returns an arbitrary Token from input.
 // checks for EOF and returns Invalid Token if found
 // calls Scanner::error(string msg), terminating on bad input.
 Token Scanner::scanToken() {
-	// remove WS, NL, and check for EOF
-	removeWS();
-	if (ensureNL()) {
-		get();
-		return scanToken();
-	} else if (input.peek() == EOF)
+	// remove WS, NL, and comments until a Token or EOF is found
+	for (;;) {
+		removeWS();
+		if (ensureNL())
+			get();
+		else if (peek() == '/')
+			removeComment(); // handles error
+		else
+			break;
+	}
+	if (peek() == EOF)
 		return Token();
 
 	Token ret;
-	switch (input.peek()) {
+	switch (peek()) {
 
 		case '=':
 			get();
@@ -86,15 +93,10 @@ Token Scanner::scanToken() {
 			ret = Token {Comma, -1};
 			break;
 
-		case '/':
-			removeComment(); // handles error
-			return scanToken();
-			break;
-
 		default:
-			if (isalpha(input.peek()))
+			if (isalpha(peek()))
 				ret = scanAlpha();
-			else if (isdigit(input.peek()))
+			else if (isdigit(peek()))
 				ret = Token {Constant, scanNumber()};
 			else
 				error("invalid character to start Token");
@@ -114,291 +116,171 @@ Token Scanner::scanToken() {
 // ensures operation begins on a new line, removes
 // leading whitespace, scans an insturction opcode,
 // ensures and removes trailing whitespace, prints
-// Token if -t was passed, and returns Instruction
-// Token.
-// checks for EOF, returning Invalid Token if found.
+// Token if -t was passed, and returns the Opcode.
+// checks for EOF, returning INVALID if found.
 // terminates on bad input via Scanner::error().
-Token Scanner::scanInstruction() {
+int Scanner::scanInstruction() {
 	// this block ensures all instructions begin on a new line:
 	//	- removes any leading whitespace
-	//	- checks for and removes comment (including new line)
-	//	- checks for and removes new line
-	//	- checks for EOF, returning Invalid Token if found
+	//	- checks for and removes comments and new lines
+	//	- checks for EOF, returning INVALID if found (in switch)
 	//	- if it is not the first line and did not find comment
 	//		or new line, then it follows other Tokens on a line
 	//		because new lines are only consumed here.
+	// blank lines and comment lines are skipped in one pass by
+	// the skipSpace() and findNL() kernels, so stack depth does
+	// not grow with the number of lines in the block.
 	removeWS();
-/*
-	if (ensureNL() || input.peek() == '/') {
-		do {
-			if (ensureNL())
-				get();
-			if (input.peek() == '/')
-				removeComment();
-		} while (ensureNL());
-	} else if (ln != 1)
-		error("all ILOC operations must begin on a new line");
-
-	// check for eof
-	if (input.peek() == EOF)
-		return Token();
-*/
-	if (ensureNL())
-		get();
-	else if (input.peek() == '/') {
-		while (input.peek() == '/') {
+	if (ensureNL() || peek() == '/') {
+		for (;;) {
+			cur = skipSpace(cur, last);
+			if (cur == last && refill())
+				continue;
+			if (peek() != '/')
+				break;
 			removeComment();
-			get();	// consume new line
 		}
-	} else if (input.peek() == EOF)
-		return Token();
-	else if (ln != 1)
+	} else if (peek() != EOF && line() != 1)
 		error("all ILOC operations must begin on a new line");
 
-	removeWS();
-
-	// accounts for blank lines
-	if (ensureNL() || input.peek() == '/')
-		return scanInstruction();
-/*
-	if (input.peek() == '/') {
-		removeComment();
-		return scanInstruction();
-	}
-*/
-
-	Token ret = Token {Instruct, INT_MIN};
-	switch (get()) {
-
-		case 's':
-			switch (get()) {
-
-				// "store"
-				case 't':
-					if (get() == 'o' && get() == 'r' && get() == 'e')
-						ret.value = store;
-					else
-						error("expected opcode \"store\"");
-					break;
-					
-				// "sub"
-				case 'u':
-					if (get() == 'b')
-						ret.value = sub;
-					else
-						error("expected opcode \"sub\"");
-					break;
-
-				default:
-					error("invalid character following 's'");
-			}
-			break;
-
-		case 'l':
-			switch (get()) {
-
-				case 'o':
-					if (get() == 'a' && get() == 'd') {
-						// "loadI"
-						if (input.peek() == 'I') {
-							get();
-							ret.value = loadI;
-						// "load"
-						} else
-							ret.value = load;
-					} else
-						error("expected opcode \"load\" or \"loadI\"");
-					break;
-
-				case 's':
-					// "lshift"
-					if (get() == 'h' && get() == 'i' &&
-						get() == 'f' && get() == 't')
-							ret.value = lshift;
-					else
-						error("expected opcode \"lshift\"");
-					break;
-
-				default:
-					error("invalid character following 'l'");
-			}
-			break;
-
-		case 'r':
-			// "rshift"
-			if (get() == 's' && get() == 'h' &&
-				get() == 'i' && get() == 'f' && get() == 't')
-					ret.value = rshift;
-			else
-				error("expected opcode \"rshift\"");
-			break;
-
-		case 'm':
-			// "mult"
-			if (get() == 'u' && get() == 'l' && get() == 't')
-				ret.value = mult;
-			else
-				error("expected opcode \"mult\"");
-			break;
-
-		case 'a':
-			// "add"
-			if (get() == 'd' && get() == 'd')
-				ret.value = add;
-			else
-				error("expected opcode \"add\"");
-			break;
-
-		case 'n':
-			// "nop"
-			if (get() == 'o' && get() == 'p')
-				ret.value = nop;
-			else
-				error("expected opcode \"nop\"");
-			break;
-
-		case 'o':
-			// "output"
-			if (get() == 'u' && get() == 't' &&
-				get() == 'p' && get() == 'u' && get() == 't')
-					ret.value = output;
-			else
-				error("expected opcode \"output\"");
-			break;
-
-		case '/':
-			removeComment();
-			return scanInstruction();
-
-		case EOF:
-			return Token();
-
-		default:
-			error("expected instruction opcode");
-			break;
-	}
+	if (peek() == EOF)
+		return INVALID;
+	int op = scanOpcode();
 
 	if (ensureWS())
 		removeWS();
-	else if (ret.value != nop)	// bc nop can be immediately followed by NL
+	else if (op != nop)	// bc nop can be immediately followed by NL
 		error("no whitespace following valid opcode");
 
-	if (print)
-		cerr << ret << endl;
+	printToken(Instruct, op);
 
-	return ret;
+	return op;
 }
 
 
-// scans a register, removes trailing
-// whitespace, prints Token if -t was passed,
-// and returns a Register Token.
+// scans a register, removes trailing whitespace,
+// prints Token if -t was passed, and returns
+// the register number.
 // terminates on bad input via Scanner::error().
-//
-// ret defined as invalid Token, but only valid
-// Register Token will be returned due to error().
-Token Scanner::scanRegister() {
-	Token ret = Token();
+int Scanner::scanRegister() {
+	int ret = INVALID;
 	if (get() == 'r') {
-		if (isdigit(input.peek())) {
-			ret = Token {Reg, scanNumber()};
+		if (isdigit(peek())) {
+			ret = scanNumber();
 			removeWS();
 		} else
 			error("expected register number");
 	} else
 		error("expected register");
-	if (print)
-		cerr << ret << endl;
+	printToken(Reg, ret);
 	return ret;
 }
 
 
 // scans a numerical constant, removes trailing
 // whitespace, prints Token if -t was passed,
-// and returns a Constant Token.
+// and returns the constant.
 // terminates on bad input via Scanner::error().
-//
-// ret defined as invalid Token, but only valid
-// Constant Token will be returned due to error().
-Token Scanner::scanConstant() {
-	Token ret = Token();
-	if (isdigit(input.peek())) {
-		ret = Token {Constant, scanNumber()};
+int Scanner::scanConstant() {
+	int ret = INVALID;
+	if (isdigit(peek())) {
+		ret = scanNumber();
 		removeWS();
 	} else
 		error("expected numerical constant");
-	if (print)
-		cerr << ret << endl;
+	printToken(Constant, ret);
 	return ret;
 }
 
 
-// scans an arrow, removes trailing
-// whitespace, prints Token if -t was passed,
-// and returns an Arrow Token.
+// scans an arrow, removes trailing whitespace,
+// and prints Token if -t was passed.
 // terminates on bad input via Scanner::error().
-//
-// ret defined as invalid Token, but only valid
-// Arrow Token will be returned due to error().
-Token Scanner::scanArrow() {
-	Token ret = Token();
-	if (get() == '=' && get() == '>') {
+void Scanner::scanArrow() {
+	if (get() == '=' && get() == '>')
 		removeWS();
-		ret = Token {Arrow, -1};
-	} else
+	else
 		error("expected assignment arrow");
-	if (print)
-		cerr << ret << endl;
-	return ret;
+	printToken(Arrow, -1);
 }
 
 
-// scans a comma, removes trailing
-// whitespace, and returns a Comma Token.
+// scans a comma, removes trailing whitespace,
+// and prints Token if -t was passed.
 // terminates on bad input via Scanner::error().
-//
-// ret defined as invalid Token, but only valid
-// Comma Token will be returned due to error().
-Token Scanner::scanComma() {
-	Token ret = Token();
-	if (get() == ',') {
+void Scanner::scanComma() {
+	if (get() == ',')
 		removeWS();
-		ret = Token {Comma, -1};
-	} else
+	else
 		error("expected comma to separate register arguments");
-	if (print)
-		cerr << ret << endl;
-	return ret;
+	printToken(Comma, -1);
 }
 
 
 //// private Scanner methods ////
 
 
-// extension of std::istream::get()
-// adds line/position counting functionality.
+// returns next character of input
+// without consuming it, or EOF.
+int Scanner::peek() {
+	if (cur == last && !refill())
+		return EOF;
+	return (unsigned char)*cur;
+}
+
+
+// consumes and returns next character of input, or EOF.
+// EOF reads are counted so column() matches the
+// position the error would have been reported at.
 int Scanner::get() {
-	pos++;
-	if (ensureNL()) {
-		ln++;
-		pos = 0;
+	if (cur == last && !refill()) {
+		++eofReads;
+		return EOF;
 	}
-	return input.get();
+	return (unsigned char)*cur++;
+}
+
+
+// moves to the next window of streamed input once
+// the current one has been consumed, counting the
+// new lines in the window being discarded.
+// returns false at end of input (or if not streaming).
+bool Scanner::refill() {
+	if (src == nullptr || !src->streaming())
+		return false;
+	nls += countNL(base, last);
+	bool more = src->refill();
+	base = cur = src->begin();
+	last = src->end();
+	return more;
 }
 
 
-// extension of std::istream::get(char& c)
-// adds line/position counting functionality.
-istream& Scanner::get(char& c) {
-	c = get();
-	return input;
+// computes current line number by counting
+// the new lines consumed so far (including
+// those in windows already discarded).
+// only called when reporting errors, or when checking
+// that the first instruction of a block is on line 1.
+int Scanner::line() {
+	return 1 + nls + countNL(base, cur);
+}
+
+
+// computes index of last consumed character on current
+// line (0 immediately after consuming a new line).
+int Scanner::column() {
+	const char* c = cur;
+	while (c != base && c[-1] != '\n' && c[-1] != '\r'
+							&& c[-1] != '\f' && c[-1] != '\v')
+		--c;
+	return (cur - c) + eofReads;
 }
 
 
 // indicates whether or not next
 // input character is whitespace.
 bool Scanner::ensureWS() {
-	int c = input.peek();
+	int c = peek();
 	return c == ' ' || c == '\t';
 }
 
@@ -406,25 +288,29 @@ bool Scanner::ensureWS() {
 // indicates whether or not next input 
 // character will produce a new line.
 bool Scanner::ensureNL() {
-	int c = input.peek();
+	int c = peek();
 	return c == '\n' || c == '\r' || c == '\f' || c == '\v';
 }
 
 
 // consumes whitespace from input.
+// most runs are a single character, so only
+// longer runs are handed to the skipBlank() kernel.
 void Scanner::removeWS() {
-	while (ensureWS())
-		get();
+	if (ensureWS()) {
+		++cur;
+		if (ensureWS())
+			cur = skipBlank(cur, last);
+	}
 }
 
 
 // checks for "//" then consumes remainder of line
+// (up to, but not including, the new line).
 void Scanner::removeComment() {
-	if (get() == '/' && get() == '/') {
-		while (!ensureNL() && input.peek() != EOF)
-			get();
-//		get();
-	} else
+	if (get() == '/' && get() == '/')
+		cur = findNL(cur, last);
+	else
 		error("invalid '/'; epected comment");
 }
 
@@ -432,8 +318,12 @@ void Scanner::removeComment() {
 // prints explicit error message to 
 // console and terminates program.
 // to be called when bad input is encountered.
+// if not fatal, throws INVALID instead, leaving
+// the caller to decide how to report the error.
 void Scanner::error(string msg) {
-	cerr << infile << ":" << ln << ":" << pos << ": ERROR: "
+	if (!fatal)
+		throw INVALID;
+	cerr << infile << ":" << line() << ":" << column() << ": ERROR: "
 		<< msg << endl << "Terminating program." << endl;
 	exit(EXIT_FAILURE);
 }
@@ -442,131 +332,113 @@ void Scanner::error(string msg) {
 // scans and returns numerical value from input.
 // does not check that first char is in fact
 // digit and does not handle error if not.
-// thus, caller must perform check
+// thus, caller must perform check.
+// the value is accumulated digit by digit as it
+// is scanned, terminating if it exceeds INT_MAX.
 int Scanner::scanNumber() {
-	string num = "";
-	while (isdigit(input.peek()))
-		num += get();
-	return stoi(num);
+	int num = 0;
+	while (isdigit(peek())) {
+		int d = get() - '0';
+		if (num > (INT_MAX - d) / 10)
+			error("numerical value out of range");
+		num = num * 10 + d;
+	}
+	return num;
 }
 
 
-// helper to scanToken().
-// scans and returns Instruction Tokens and Register Tokens.
-//
-// separated from scanToken() to reduce clutter
-// and to allow ensuring and eliminating whitespace 
-// following Instruction Tokens while avoiding errors
-// arising from recursing on whitespace in default
-// case of scanToken().
-Token Scanner::scanAlpha() {
-	int op = INT_MIN;
-	switch (get()) {
-
-		case 's':
-			switch (get()) {
-
-				// "store"
-				case 't':
-					if (get() == 'o' && get() == 'r' && get() == 'e')
-						op = store;
-					else
-						error("expected opcode \"store\"");
-					break;
-					
-				// "sub"
-				case 'u':
-					if (get() == 'b')
-						op = sub;
-					else
-						error("expected opcode \"sub\"");
-					break;
-
-				default:
-					error("invalid character following 's'");
-			}
-			break;
+// prints a Token built from cat and value
+// if -t was passed. Tokens are only
+// constructed when they are to be printed.
+void Scanner::printToken(TokenCat cat, int value) {
+	if (print)
+		cerr << Token {cat, value} << endl;
+}
 
-		case 'l':
-			switch (get()) {
-
-				case 'o':
-					if (get() == 'a' && get() == 'd') {
-						// "loadI"
-						if (input.peek() == 'I') {
-							get();
-							op = loadI;
-						// "load"
-						} else
-							op = load;
-					} else
-						error("expected opcode \"load\" or \"loadI\"");
-					break;
-
-				case 's':
-					// "lshift"
-					if (get() == 'h' && get() == 'i' &&
-						get() == 'f' && get() == 't')
-							op = lshift;
-					else
-						error("expected opcode \"lshift\"");
-					break;
-
-				default:
-					error("invalid character following 'l'");
-			}
-			break;
 
-		case 'r':
-			// register
-			if (isdigit(input.peek()))
-				return Token {Reg, scanNumber()};
-			// "rshift"
-			else if (get() == 's' && get() == 'h' &&
-				get() == 'i' && get() == 'f' && get() == 't')
-					op = rshift;
-			else
-				error("expected valid register number or opcode \"rshift\"");
-			break;
+// scans and returns an Opcode.
+// the mnemonic (the run of letters at cur) is looked up
+// with a single probe of the perfect hash in opTable.
+// anything else is handed to matchOpcode().
+int Scanner::scanOpcode() {
+	const char* p = cur;
+	while (p != last && p - cur <= MAX_MNEMONIC && isalpha((unsigned char)*p))
+		++p;
+	int op = lookupOpcode(cur, p - cur);
+	if (op == NO_OPCODE)
+		return matchOpcode();
+	cur = p;
+	return op;
+}
 
-		case 'm':
-			// "mult"
-			if (get() == 'u' && get() == 'l' && get() == 't')
-				op = mult;
-			else
-				error("expected opcode \"mult\"");
-			break;
 
-		case 'a':
-			// "add"
-			if (get() == 'd' && get() == 'd')
-				op = add;
-			else
-				error("expected opcode \"add\"");
-			break;
+// helper to scanOpcode().
+// matches input against the mnemonics in opInfo one
+// character at a time, consuming the longest prefix
+// of input that is a mnemonic or a prefix of one.
+// only called when the run of letters at cur is not a
+// mnemonic, so it either finds a mnemonic followed
+// directly by another letter (e.g. "nopx", which is
+// left for the caller to reject), or terminates via
+// Scanner::error() at the first character that cannot
+// continue any mnemonic.
+int Scanner::matchOpcode() {
+	string prefix = "";	// characters matched so far
+	for (;;) {
+		size_t n = prefix.size();
+		int complete = NO_OPCODE;	// mnemonic equal to prefix, if any
+		string expected = "";		// longer mnemonics beginning with prefix
+		bool forks = false;			// they differ at character n
+		bool extends = false;		// one of them continues with peek()
+		for (int op = 0; op < NUM_OPCODES; ++op) {
+			const OpInfo& info = opInfo[op];
+			if (string(info.name).compare(0, n, prefix) != 0)
+				continue;
+			if (info.len == (int)n)
+				complete = op;
+			else {
+				if (expected != "" && info.name[n] != expected[n + 2])
+					forks = true;
+				expected += string(expected == "" ? " " : " or ")
+							+ "\"" + info.name + "\"";
+				if (info.name[n] == peek())
+					extends = true;
+			}
+		}
 
-		case 'n':
-			// "nop"
-			if (get() == 'o' && get() == 'p')
-				op = nop;
+		if (!extends) {
+			if (complete != NO_OPCODE)
+				return complete;
+			// consume offending character and report error
+			get();
+			if (n == 0)
+				error("expected instruction opcode");
+			else if (forks)
+				error("invalid character following '" + prefix.substr(n - 1) + "'");
 			else
-				error("expected opcode \"nop\"");
-			break;
+				error("expected opcode" + expected);
+		}
 
-		case 'o':
-			// "output"
-			if (get() == 'u' && get() == 't' &&
-				get() == 'p' && get() == 'u' && get() == 't')
-					op = output;
-			else
-				error("expected opcode \"output\"");
-			break;
+		prefix += get();
+	}
+}
 
-		default:
-			error("expected valid register or instruction opcode");
-			break;
+
+// helper to scanToken().
+// scans and returns Instruction Tokens and Register Tokens.
+//
+// separated from scanToken() to reduce clutter
+// and to allow ensuring and eliminating whitespace 
+// following Instruction Tokens.
+Token Scanner::scanAlpha() {
+	// register
+	if (peek() == 'r' && cur + 1 != last && isdigit((unsigned char)cur[1])) {
+		get();
+		return Token {Reg, scanNumber()};
 	}
 
+	int op = scanOpcode();
+
 	if (ensureWS())
 		removeWS();
 	else if (op != nop)	// bc nop can be immediately followed by NL
@@ -586,52 +458,10 @@ ostream& operator<<(ostream& os, const Token& t) {
 
 		case Instruct:
 			os << "INST, ";
-			switch (t.value) {
-
-				case load:
-					os << "load";
-					break;
-
-				case loadI:
-					os << "loadI";
-					break;
-
-				case store:
-					os << "store";
-					break;
-
-				case add:
-					os << "add";
-					break;
-
-				case sub:
-					os << "sub";
-					break;
-
-				case mult:
-					os << "mult";
-					break;
-
-				case lshift:
-					os << "lshift";
-					break;
-
-				case rshift:
-					os << "rshift";
-					break;
-
-				case output:
-					os << "output";
-					break;
-
-				case nop:
-					os << "nop";
-					break;
-
-				default:
-					os << "Invalid, this should never happen";
-					break;
-			}
+			if (t.value >= 0 && t.value < NUM_OPCODES)
+				os << opInfo[t.value].name;
+			else
+				os << "Invalid, this should never happen";
 			break;
 
 		case Reg:
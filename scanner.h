@@ -2,8 +2,8 @@
  *                                                   *
  * scanner.h                                         *
  *                                                   *
- * Contains declarations for TokenCat and Opcode     *
- * enumerations, Token structure, and Scanner class, *
+ * Contains declarations for TokenCat enumeration,   *
+ * Token structure, and Scanner class,               *
  * as well as all necessary import and using         *
  * statements.                                       *
  *                                                   *
@@ -13,7 +13,10 @@
 
 #pragma once
 
-#include <iostream> // ostream, cout, endl, istream, cerr
+#include "input.h"
+#include "kernels.h"
+#include "opcodes.h"
+#include <iostream> // ostream, cout, endl, cerr
 #include <fstream>	// ifstream
 #include <string>
 #include <cctype>	// isdigit(), isspace(), isalpha()
@@ -24,7 +27,6 @@
 using std::string;
 using std::ostream;
 using std::ifstream;
-using std::istream;
 using std::cout;
 using std::endl;
 using std::getline;
@@ -45,21 +47,6 @@ enum TokenCat {
 };
 
 
-/// Opcodes ///
-enum Opcode {
-	load,
-    loadI,
-    store,
-    add,
-    sub,
-    mult,
-    lshift,
-    rshift,
-    output,
-    nop
-};
-
-
 ////// Token structure //////
 
 struct Token {
@@ -77,28 +64,41 @@ struct Token {
 class Scanner {
 	public:
 		Scanner();						// default constructor
-		Scanner(string f, bool=false);	// normal constructor
-		Scanner(const Scanner& s);		// copy constructor
-		~Scanner();				// deconstructor, closes input file stream
+		Scanner(Input& in, bool=false);	// normal constructor, scans all of in
+		// range constructor. scans [b, e) of a file
+		// whose contents begin at base (for line numbers)
+		Scanner(string f, const char* base, const char* b, const char* e,
+				bool=false, bool=true);
 		Token scanToken();		// scans and returns arbitrary Token
-		Token scanInstruction();// scans and returns an instruction as Token
-		Token scanRegister();	// scans and returns a register as Token
-		Token scanConstant();	// scans and returns an int as Token
-		Token scanArrow();		// scans and returns assignment arrow as Token
-		Token scanComma();		// scans and returns a comma as Token
+		int scanInstruction();	// scans and returns an Opcode (INVALID on EOF)
+		int scanRegister();		// scans and returns a register number
+		int scanConstant();		// scans and returns a numerical constant
+		void scanArrow();		// scans an assignment arrow
+		void scanComma();		// scans a comma
 	private:
 		string infile;			// name of input file
-		ifstream input;			// input file stream
+		Input* src;				// refills window if streaming (or nullptr)
+		int nls;				// new lines in windows already discarded
+		const char* base;		// first character of input file (or window)
+		const char* cur;		// next character to be scanned
+		const char* last;		// one past last character to be scanned
 		bool print;				// indicates whether -t option was passed
-		int ln;					// current line number
-		int pos;				// index of character on current line
-		int get();				// extension of std::ifstream::get()
-		istream& get(char& c);	// extension of std::ifstream::get(char& c)
+		bool fatal;				// indicates whether error() terminates
+		int eofReads;			// number of get() calls made at EOF
+		int peek();				// returns next character without consuming it
+		int get();				// consumes and returns next character
+		bool refill();			// moves to next window of streamed input
+		int line();				// computes current line number
+		int column();			// computes index of character on current line
 		bool ensureWS();		// returns bool indicating presences of WS
 		bool ensureNL();		// returns bool indicating presence of new line
 		void removeWS();		// scans and discards whitespace
 		void removeComment();	// scans and discards a comment
 		void error(string msg);	// prints explicit error message and terminates
+								// (or throws INVALID if not fatal)
 		int scanNumber();		// scans and returns an int
+		int scanOpcode();		// scans and returns an Opcode
+		int matchOpcode();		// scanOpcode() helper, for unhashed input
+		void printToken(TokenCat cat, int value);	// prints Token if -t
 		Token scanAlpha();		// scanToken() helper, called on alpha characters
 };
@@ -0,0 +1,77 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                     *
+ * sidefile.cpp                                        *
+ *                                                     *
+ * Contains implementation of SideFile class.          *
+ *                                                     *
+ * Records go straight to the file with pread() and    *
+ * pwrite(), at their offset, so nothing but the       *
+ * caller's chunk is ever held in memory.              *
+ *                                                     *
+ * Written by: Austin James Lee                        *
+ *                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "sidefile.h"
+#include <unistd.h>		// pread(), pwrite()
+
+// helper function prototypes
+static void failed(string what);
+
+
+// constructor
+// opens an unnamed temporary file (tmpfile() removes it
+// itself once it is closed, even if alloc is killed).
+// terminates if none can be made.
+SideFile::SideFile() :file{tmpfile()}, fd{-1} {
+	if (file == nullptr)
+		failed("create");
+	fd = fileno(file);
+}
+
+
+// destructor
+SideFile::~SideFile() {
+	fclose(file);
+}
+
+
+// writes n records from r, the first at record index at.
+// terminates if they cannot all be written.
+void SideFile::write(long at, const SideRecord* r, int n) {
+	const char* b = (const char*)r;
+	size_t left = n * sizeof(SideRecord);
+	off_t off = at * sizeof(SideRecord);
+	while (left > 0) {
+		ssize_t w = pwrite(fd, b, left, off);
+		if (w <= 0)
+			failed("write");
+		b += w;
+		left -= w;
+		off += w;
+	}
+}
+
+
+// reads n records into r, the first from record index at.
+// terminates if they are not all there.
+void SideFile::read(long at, SideRecord* r, int n) {
+	char* b = (char*)r;
+	size_t left = n * sizeof(SideRecord);
+	off_t off = at * sizeof(SideRecord);
+	while (left > 0) {
+		ssize_t g = pread(fd, b, left, off);
+		if (g <= 0)
+			failed("read");
+		b += g;
+		left -= g;
+		off += g;
+	}
+}
+
+
+// prints error message about the temporary file and terminates
+static void failed(string what) {
+	cerr << "error: could not " << what << " temporary file" << endl;
+	exit(EXIT_FAILURE);
+}
@@ -0,0 +1,58 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                     *
+ * sidefile.h                                          *
+ *                                                     *
+ * Contains declarations for the SideRecord structure  *
+ * and SideFile class, which hold a block on disk      *
+ * while it is allocated in stream mode, as well as    *
+ * all necessary includes and using statements not     *
+ * already present in ir.h and scanner.h.              *
+ *                                                     *
+ * A SideFile is an unnamed temporary file of          *
+ * SideRecords, one per instruction, in block order,   *
+ * that can be read and written anywhere a chunk at a  *
+ * time. It is removed when it is closed.              *
+ *                                                     *
+ * Written by: Austin James Lee                        *
+ *                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#pragma once
+
+#include "ir.h"
+#include <cstdint>	// int32_t
+
+using std::int32_t;
+
+
+//// SideRecord structure ////
+
+// an instruction of the block, with its operands indexed by slot
+// (as in IR), and what is known of the value it defines
+struct SideRecord {
+	int32_t op;			// Opcode
+	int32_t sr[3];		// source register (renamed) or constant
+	int32_t vr[3];		// virtual register
+	int32_t nu[3];		// index of next use of the register
+	int32_t clean;		// Clean type of dest vr
+	int32_t mem;		// spill (or remat) address of dest vr
+	int32_t uses;		// number of uses of dest vr
+};
+
+
+//// SideFile class ////
+
+class SideFile {
+	public:
+		SideFile();		// creates empty file (terminates on failure)
+		~SideFile();	// closes (and so removes) file
+		// writes n records from r, the first of which is record at
+		void write(long at, const SideRecord* r, int n);
+		// reads n records into r, starting with record at
+		void read(long at, SideRecord* r, int n);
+	private:
+		SideFile(const SideFile&);				// not copyable
+		SideFile& operator=(const SideFile&);	// not assignable
+		FILE* file;		// temporary file
+		int fd;			// its descriptor
+};